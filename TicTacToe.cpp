@@ -9,6 +9,43 @@
 #include <utility>   // std::pair, std::make_pair
 #include <cmath>     // std::log, std::sqrt
 #include <cctype>    // toupper
+#include <cstring>   // strcmp, memcmp, memcpy
+#include <thread>    // std::thread
+#include <mutex>     // std::mutex, std::lock_guard, std::unique_lock
+#include <condition_variable>
+#include <functional> // std::function
+#include <deque>     // std::deque
+#include <chrono>    // std::chrono::steady_clock
+#include <atomic>    // std::atomic
+#include <iomanip>   // std::setw
+#include <sstream>   // std::ostringstream
+#include <fstream>   // std::ofstream, std::ifstream
+#include <iterator>  // std::istreambuf_iterator
+#include <new>       // std::bad_alloc, std::nothrow_t
+#include <memory>    // std::shared_ptr
+#include <coroutine> // std::coroutine_handle, std::suspend_always
+#include <charconv>  // std::to_chars
+#include <cstdio>    // FILE, fopen, fwrite, fflush
+
+#include "tictactoe.h" // C ABI (ttt_*)
+
+#ifdef __unix__
+#include <unistd.h>           // write, read, close, syscall, fsync
+#include <fcntl.h>            // open
+#endif
+
+#ifdef __linux__
+#include <linux/perf_event.h> // perf_event_attr, PERF_COUNT_*
+#include <sys/ioctl.h>        // ioctl
+#include <sys/syscall.h>      // SYS_perf_event_open, SYS_futex
+#include <sys/mman.h>         // shm_open, mmap
+#include <sys/stat.h>         // S_IRUSR, S_IWUSR
+#include <linux/futex.h>      // FUTEX_WAIT, FUTEX_WAKE
+#include <csignal>            // sigaction, SIGINT, SIGTERM
+#include <cerrno>             // errno, EINTR
+#include <pthread.h>          // pthread_setschedparam
+#include <sched.h>            // SCHED_IDLE
+#endif
 
 using namespace std;
 
@@ -39,11 +76,8 @@ typedef pair<int, int> Move;
 
 // Game / board helpers
 void resetBoard();
-void printBoard();
-void printPastMoves(char mode);
 int  countFreeSpaces(const char b[BOARD_SIZE][BOARD_SIZE]);
 char checkWinner(const char b[BOARD_SIZE][BOARD_SIZE]);
-void printWinnerMessage(char winner, char chosenMode);
 
 // Input helpers
 void handlePlayerMove(char playerChar, vector<pair<int,int> >& moveLog);
@@ -58,663 +92,5413 @@ int  getMctsIterationsForDifficulty(char aiChoice);
 // Minimax
 int  minimax(char currentBoard[BOARD_SIZE][BOARD_SIZE],
              int depth, bool isMaximizing,
-             int alpha, int beta);
+             int alpha, int beta,
+             const atomic<bool>* cancel = NULL);
 void minimaxMove();
 
 // ===============================
-// MCTS STRUCT AND FUNCTIONS
+// POSITION KEYS
 // ===============================
 
-struct MCTSNode;
-typedef MCTSNode* NodePtr;
+// Number of distinct 3x3 boards (3^9), reachable or not.
+const int POSITION_COUNT = 19683;
 
-// Node in the Monte Carlo Tree.
-struct MCTSNode {
-    char boardState[BOARD_SIZE][BOARD_SIZE]; // board at this node
-    char playerToMove;                       // whose turn at this node
-    Move lastMove;                           // move that led to this node
-
-    int W;  // number of simulations that resulted in a COMPUTER win
-    int N;  // number of times this node was visited
-
-    NodePtr parent;
-    vector<NodePtr> children;
-    vector<Move> untriedMoves; // legal moves we haven’t expanded yet
-
-    MCTSNode(const char b[BOARD_SIZE][BOARD_SIZE],
-             NodePtr p,
-             const Move& lm,
-             char nextPlayer)
-        : W(0),
-          N(0),
-          parent(p),
-          lastMove(lm),
-          playerToMove(nextPlayer)
-    {
-        // Copy board and gather all empty cells as untried moves.
-        for (int i = 0; i < BOARD_SIZE; ++i) {
-            for (int j = 0; j < BOARD_SIZE; ++j) {
-                boardState[i][j] = b[i][j];
-                if (b[i][j] == ' ') {
-                    untriedMoves.push_back(make_pair(i, j));
-                }
-            }
+const int POWERS_OF_3[9] = {1, 3, 9, 27, 81, 243, 729, 2187, 6561};
+
+// Cell permutations of the eight board symmetries: SYMMETRIES[s][cell] is
+// where `cell` lands under symmetry s (identity, rotations, reflections).
+const int SYMMETRIES[8][9] = {
+    {0, 1, 2, 3, 4, 5, 6, 7, 8},
+    {2, 5, 8, 1, 4, 7, 0, 3, 6},
+    {8, 7, 6, 5, 4, 3, 2, 1, 0},
+    {6, 3, 0, 7, 4, 1, 8, 5, 2},
+    {2, 1, 0, 5, 4, 3, 8, 7, 6},
+    {6, 7, 8, 3, 4, 5, 0, 1, 2},
+    {0, 3, 6, 1, 4, 7, 2, 5, 8},
+    {8, 5, 2, 7, 4, 1, 6, 3, 0},
+};
+
+/**
+ * A whole position in 16 bits: the board read as a base-3 number, cell
+ * r * 3 + c contributing 3^(r * 3 + c) times 0 (empty), 1 (X) or 2 (O).
+ * The code indexes flat tables directly, compares as an integer and is
+ * what logs, the shared-memory protocol and the C ABI exchange, so no
+ * layer has to copy or compare board arrays. The side to move follows
+ * from the piece counts.
+ */
+struct PositionKey {
+    uint16_t code;
+
+    static PositionKey fromCode(uint32_t code) {
+        PositionKey key = { static_cast<uint16_t>(code) };
+        return key;
+    }
+
+    static PositionKey fromBoard(const char b[BOARD_SIZE][BOARD_SIZE]) {
+        uint32_t code = 0;
+        for (int cell = BOARD_SIZE * BOARD_SIZE - 1; cell >= 0; --cell) {
+            code = code * 3 + digitFor(b[cell / BOARD_SIZE][cell % BOARD_SIZE]);
+        }
+        return fromCode(code);
+    }
+
+    static int digitFor(char mark) {
+        return (mark == PLAYER) ? 1 : (mark == COMPUTER) ? 2 : 0;
+    }
+
+    bool inRange() const { return code < POSITION_COUNT; }
+
+    /** 0 empty, 1 X, 2 O. */
+    int digit(int cell) const { return code / POWERS_OF_3[cell] % 3; }
+
+    /** PLAYER, COMPUTER or ' '. */
+    char mark(int cell) const {
+        int d = digit(cell);
+        return (d == 1) ? PLAYER : (d == 2) ? COMPUTER : ' ';
+    }
+
+    void toBoard(char b[BOARD_SIZE][BOARD_SIZE]) const {
+        uint32_t rest = code;
+        for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE; ++cell, rest /= 3) {
+            b[cell / BOARD_SIZE][cell % BOARD_SIZE] =
+                (rest % 3 == 1) ? PLAYER : (rest % 3 == 2) ? COMPUTER : ' ';
+        }
+    }
+
+    /** Marks on the board. */
+    int marks() const {
+        int count = 0;
+        for (uint32_t rest = code; rest != 0; rest /= 3) {
+            count += (rest % 3 != 0);
+        }
+        return count;
+    }
+
+    char sideToMove() const { return (marks() % 2 == 0) ? PLAYER : COMPUTER; }
+
+    /** Key after `mark` is placed on the empty `cell`. */
+    PositionKey withMove(int cell, char mark) const {
+        return fromCode(code + POWERS_OF_3[cell] * digitFor(mark));
+    }
+
+    /** Image under symmetry `sym` (see SYMMETRIES). */
+    PositionKey transformed(int sym) const {
+        uint32_t image = 0;
+        uint32_t rest = code;
+        for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE; ++cell, rest /= 3) {
+            image += (rest % 3) * POWERS_OF_3[SYMMETRIES[sym][cell]];
         }
+        return fromCode(image);
     }
 
-    ~MCTSNode() {
-        // Recursively delete children to avoid memory leaks.
-        for (size_t i = 0; i < children.size(); ++i) {
-            delete children[i];
+    /**
+     * Smallest of the eight symmetric images; positions in the same
+     * symmetry class share it. `symmetry`, if given, receives the
+     * transform that maps this position onto it.
+     */
+    PositionKey canonical(int* symmetry = NULL) const {
+        PositionKey best = *this;
+        int bestSym = 0;
+        for (int sym = 1; sym < 8; ++sym) {
+            PositionKey image = transformed(sym);
+            if (image.code < best.code) {
+                best = image;
+                bestSym = sym;
+            }
         }
+        if (symmetry != NULL) *symmetry = bestSym;
+        return best;
+    }
+
+    /**
+     * 64-bit hash that is the same on every build and platform (SplitMix64
+     * finaliser), for hashed tables and anything persisted.
+     */
+    uint64_t hash() const {
+        uint64_t z = code + 0x9e3779b97f4a7c15ULL;
+        z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+        z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+        return z ^ (z >> 31);
     }
+
+    bool operator==(const PositionKey& other) const { return code == other.code; }
+    bool operator!=(const PositionKey& other) const { return code != other.code; }
+    bool operator<(const PositionKey& other) const { return code < other.code; }
 };
 
+// ===============================
+// ALLOCATION ACCOUNTING
+// ===============================
+
 /**
- * Calculate UCT (Upper Confidence Bound for Trees) for a child node.
- * This balances:
- *   - exploitation: how good this node has been so far
- *   - exploration: how much we still need to try it
+ * Heap allocation counters. Build with -DTTT_COUNT_ALLOCATIONS to replace
+ * the global operator new/delete with counting versions; otherwise every
+ * count reads as zero and allocationCountingEnabled() is false.
+ *
+ * Counters are process-wide so allocations made on task pool threads on
+ * behalf of a search are included.
  */
-double calculateUCT(NodePtr node, int parentVisits) {
-    const double C = 1.414; // exploration constant ~ sqrt(2)
-    if (node->N == 0) {
-        // If node was never visited, treat it as extremely promising.
-        return INT_MAX;
+struct AllocationCounts {
+    long long allocations; // calls to operator new
+    long long bytes;       // bytes requested from operator new
+    long long frees;       // calls to operator delete with a non-null pointer
+};
+
+#ifdef TTT_COUNT_ALLOCATIONS
+atomic<long long> allocationCount(0);
+atomic<long long> allocationBytes(0);
+atomic<long long> freeCount(0);
+
+void* operator new(size_t size) {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    allocationBytes.fetch_add(static_cast<long long>(size), memory_order_relaxed);
+    void* p = malloc(size > 0 ? size : 1);
+    if (p == NULL) {
+        throw bad_alloc();
     }
-    double winRate     = static_cast<double>(node->W) / node->N;
-    double exploration = C * sqrt(log(static_cast<double>(parentVisits)) / node->N);
-    return winRate + exploration;
+    return p;
 }
 
-/**
- * Among all children, pick the one with the highest UCT value.
- */
-NodePtr selectBestChild(NodePtr node) {
-    NodePtr bestChild = NULL;
-    double bestUCT = -1.0;
+void* operator new[](size_t size) {
+    return operator new(size);
+}
 
-    for (size_t i = 0; i < node->children.size(); ++i) {
-        NodePtr child = node->children[i];
-        double uct = calculateUCT(child, node->N);
+void* operator new(size_t size, const nothrow_t&) noexcept {
+    allocationCount.fetch_add(1, memory_order_relaxed);
+    allocationBytes.fetch_add(static_cast<long long>(size), memory_order_relaxed);
+    return malloc(size > 0 ? size : 1);
+}
 
-        if (uct > bestUCT) {
-            bestUCT = uct;
-            bestChild = child;
-        }
-    }
-    return bestChild;
+void* operator new[](size_t size, const nothrow_t& tag) noexcept {
+    return operator new(size, tag);
 }
 
-/**
- * Expand by taking one untried move and creating a new child node.
- */
-NodePtr expandNode(NodePtr node) {
-    // Take a move from the end of the vector.
-    Move move = node->untriedMoves.back();
-    node->untriedMoves.pop_back();
+// GCC pairs the inlined free() below with the new-expression at the call
+// site and warns; memory from our operator new comes from malloc, so it's fine.
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wmismatched-new-delete"
+#endif
 
-    // Copy board.
-    char newBoard[BOARD_SIZE][BOARD_SIZE];
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        for (int j = 0; j < BOARD_SIZE; ++j) {
-            newBoard[i][j] = node->boardState[i][j];
-        }
+void operator delete(void* p) noexcept {
+    if (p != NULL) {
+        freeCount.fetch_add(1, memory_order_relaxed);
+        free(p);
     }
+}
 
-    // Apply the move for the current player.
-    newBoard[move.first][move.second] = node->playerToMove;
+void operator delete[](void* p) noexcept {
+    operator delete(p);
+}
 
-    // Next player is the other side.
-    char nextPlayer = (node->playerToMove == PLAYER ? COMPUTER : PLAYER);
+void operator delete(void* p, size_t) noexcept {
+    operator delete(p);
+}
 
-    NodePtr child = new MCTSNode(newBoard, node, move, nextPlayer);
-    node->children.push_back(child);
-    return child;
+void operator delete[](void* p, size_t) noexcept {
+    operator delete(p);
+}
+
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC diagnostic pop
+#endif
+
+bool allocationCountingEnabled() {
+    return true;
+}
+
+AllocationCounts currentAllocationCounts() {
+    AllocationCounts counts = { allocationCount.load(memory_order_relaxed),
+                                allocationBytes.load(memory_order_relaxed),
+                                freeCount.load(memory_order_relaxed) };
+    return counts;
 }
+#else
+bool allocationCountingEnabled() {
+    return false;
+}
+
+AllocationCounts currentAllocationCounts() {
+    AllocationCounts counts = { 0, 0, 0 };
+    return counts;
+}
+#endif
 
 /**
- * Play random moves until the game ends and return:
- *   10  -> COMPUTER wins
- *   -10 -> PLAYER wins
- *    0  -> draw
+ * Counts the allocations made while it is alive, e.g.
+ *
+ *     AllocationScope scope;
+ *     runMCTS(board, 1000);
+ *     assert(scope.counts().allocations == 0);
  */
-int simulateRandomGame(const char startBoard[BOARD_SIZE][BOARD_SIZE], char playerToMove) {
-    // Work on a temporary copy.
-    char tempBoard[BOARD_SIZE][BOARD_SIZE];
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        for (int j = 0; j < BOARD_SIZE; ++j) {
-            tempBoard[i][j] = startBoard[i][j];
-        }
+class AllocationScope {
+public:
+    AllocationScope() : start(currentAllocationCounts()) {}
+
+    AllocationCounts counts() const {
+        AllocationCounts now = currentAllocationCounts();
+        AllocationCounts delta = { now.allocations - start.allocations,
+                                   now.bytes - start.bytes,
+                                   now.frees - start.frees };
+        return delta;
     }
 
-    char currentPlayer = playerToMove;
+private:
+    AllocationCounts start;
+};
 
-    while (true) {
-        char winner = checkWinner(tempBoard);
-        if (winner != ' ') {
-            if (winner == COMPUTER) return 10;
-            if (winner == PLAYER)   return -10;
-            return 0; // 'D' draw
-        }
+// ===============================
+// LARGE ALLOCATIONS
+// ===============================
 
-        // Collect all empty spots.
-        vector<Move> freeSpaces;
-        for (int i = 0; i < BOARD_SIZE; ++i) {
-            for (int j = 0; j < BOARD_SIZE; ++j) {
-                if (tempBoard[i][j] == ' ') {
-                    freeSpaces.push_back(make_pair(i, j));
-                }
-            }
-        }
+// Back big tables with 2 MiB pages where the system allows it (--no-huge-pages).
+bool hugePagesEnabled = true;
+const size_t HUGE_PAGE_BYTES = 2 << 20;
 
-        if (freeSpaces.empty()) {
-            return 0; // No more moves -> draw.
-        }
+enum PageKind { PAGES_DEFAULT, PAGES_TRANSPARENT_HUGE, PAGES_HUGETLB };
 
-        // Pick a random empty cell.
-        int randomIndex = rand() % freeSpaces.size();
-        Move randomMove = freeSpaces[randomIndex];
-        tempBoard[randomMove.first][randomMove.second] = currentPlayer;
+/**
+ * A block from allocateLarge, with the page size it actually got.
+ */
+struct LargeAllocation {
+    void* memory;
+    size_t bytes;
+    PageKind kind;
+};
 
-        // Switch turn.
-        currentPlayer = (currentPlayer == PLAYER ? COMPUTER : PLAYER);
-    }
+const char* pageKindName(PageKind kind) {
+    if (kind == PAGES_HUGETLB) return "hugetlb 2 MiB pages";
+    if (kind == PAGES_TRANSPARENT_HUGE) return "transparent huge pages";
+    return "4 KiB pages";
 }
 
 /**
- * Backpropagate the simulation result up the tree,
- * updating visit counts (N) and win counts (W) for COMPUTER.
+ * Zeroed, 64-byte aligned memory for a large table that is accessed at
+ * random (where TLB misses dominate). With `huge` set and at least 2 MiB
+ * requested, try explicit huge pages (MAP_HUGETLB) first, then a 2 MiB
+ * aligned mapping advised for transparent huge pages, then plain pages.
+ * Throws bad_alloc when the memory isn't there.
  */
-void backpropagate(NodePtr node, int result) {
-    NodePtr current = node;
-
-    while (current != NULL) {
-        current->N++;
+LargeAllocation allocateLarge(size_t bytes, bool huge = hugePagesEnabled) {
+    LargeAllocation block = { NULL, bytes, PAGES_DEFAULT };
+#ifdef __linux__
+    if (huge && bytes >= HUGE_PAGE_BYTES) {
+        size_t rounded = (bytes + HUGE_PAGE_BYTES - 1) & ~(HUGE_PAGE_BYTES - 1);
+        void* memory = mmap(NULL, rounded, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED) {
+            block.memory = memory;
+            block.bytes = rounded;
+            block.kind = PAGES_HUGETLB;
+            return block;
+        }
 
-        // We only count COMPUTER wins as "wins".
-        int scoreToAdd = 0;
-        if (result == 10) {
-            scoreToAdd = 1; // COMPUTER won this simulation.
-        } else if (result == -10) {
-            scoreToAdd = 0; // COMPUTER lost.
+        // No reserved huge pages: map with slack, trim to a 2 MiB boundary
+        // so every page of the table can be a huge page, and ask for THP.
+        memory = mmap(NULL, rounded + HUGE_PAGE_BYTES, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (memory == MAP_FAILED) {
+            throw bad_alloc();
+        }
+        uintptr_t start = reinterpret_cast<uintptr_t>(memory);
+        uintptr_t aligned = (start + HUGE_PAGE_BYTES - 1) & ~(uintptr_t(HUGE_PAGE_BYTES) - 1);
+        if (aligned > start) {
+            munmap(memory, aligned - start);
         }
-        current->W += scoreToAdd;
+        if (start + HUGE_PAGE_BYTES > aligned) {
+            munmap(reinterpret_cast<void*>(aligned + rounded), start + HUGE_PAGE_BYTES - aligned);
+        }
+        block.memory = reinterpret_cast<void*>(aligned);
+        block.bytes = rounded;
+        block.kind = (madvise(block.memory, rounded, MADV_HUGEPAGE) == 0)
+                   ? PAGES_TRANSPARENT_HUGE : PAGES_DEFAULT;
+        return block;
+    }
+
+    void* memory = mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        throw bad_alloc();
+    }
+    if (!huge) {
+        // Keep THP=always from promoting it behind our back.
+        madvise(memory, bytes, MADV_NOHUGEPAGE);
+    }
+    block.memory = memory;
+#else
+    (void)huge;
+    block.memory = ::operator new(bytes, align_val_t(64));
+    memset(block.memory, 0, bytes);
+#endif
+    return block;
+}
 
-        current = current->parent;
+void releaseLarge(const LargeAllocation& block) {
+    if (block.memory == NULL) {
+        return;
     }
+#ifdef __linux__
+    munmap(block.memory, block.bytes);
+#else
+    ::operator delete(block.memory, align_val_t(64));
+#endif
 }
 
+// ===============================
+// DEFERRED RELEASE
+// ===============================
+
+// Hand big blocks to the reaper thread instead of unmapping them on the
+// caller's thread (--sync-free turns this off).
+bool deferLargeReleases = true;
+// Smaller blocks are cheaper to unmap than to hand over.
+const size_t DEFERRED_RELEASE_MIN_BYTES = 1 << 20;
+
 /**
- * Run the full MCTS algorithm for a chosen number of iterations,
- * and return the move the computer will play.
+ * Background thread that releases large blocks (finished search trees)
+ * off the move latency path. Unmapping a big tree touches every page
+ * table entry it used; here that happens at idle priority while the
+ * engine is already returning its move.
  */
-Move runMCTS(const char currentBoard[BOARD_SIZE][BOARD_SIZE], int iterations) {
-    // Root node: it’s COMPUTER’s turn to move.
-    NodePtr root = new MCTSNode(currentBoard, NULL, make_pair(-1, -1), COMPUTER);
+class ArenaReaper {
+public:
+    ArenaReaper() : stopping(false), busy(false), releasedBlocks(0), releasedBytes(0) {}
 
-    for (int i = 0; i < iterations; ++i) {
-        NodePtr node = root;
-
-        // ==== 1) SELECTION ====
-        // Go down the tree while the node is fully expanded (no untried moves)
-        // and the game is not over.
-        while (node->untriedMoves.empty() &&
-               checkWinner(node->boardState) == ' ' &&
-               !node->children.empty()) {
-            node = selectBestChild(node);
-            if (node == NULL) {
-                break;
-            }
+    ~ArenaReaper() {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            stopping = true;
         }
-
-        // ==== 2) EXPANSION ====
-        if (!node->untriedMoves.empty() && checkWinner(node->boardState) == ' ') {
-            node = expandNode(node);
+        wakeup.notify_one();
+        if (worker.joinable()) {
+            worker.join();
         }
+        for (size_t i = 0; i < queue.size(); ++i) {
+            releaseLarge(queue[i]);
+        }
+    }
 
-        // ==== 3) SIMULATION (ROLLOUT) ====
-        char winner = checkWinner(node->boardState);
-        int result = 0;
-
-        if (winner == ' ') {
-            // Game not finished, simulate to the end.
-            result = simulateRandomGame(node->boardState, node->playerToMove);
-        } else {
-            // Terminal state at this node.
-            if (winner == COMPUTER)      result = 10;
-            else if (winner == PLAYER)   result = -10;
-            else                         result = 0;
+    /**
+     * Release `block` later on the reaper thread.
+     */
+    void release(const LargeAllocation& block) {
+        {
+            lock_guard<mutex> lock(queueMutex);
+            queue.push_back(block);
+            if (!worker.joinable()) {
+                worker = thread(&ArenaReaper::run, this);
+            }
         }
+        wakeup.notify_one();
+    }
 
-        // ==== 4) BACKPROPAGATION ====
-        backpropagate(node, result);
+    /**
+     * Block until everything handed over so far has been released.
+     */
+    void drain() {
+        unique_lock<mutex> lock(queueMutex);
+        drained.wait(lock, [this]() { return queue.empty() && !busy; });
     }
 
-    // After all simulations, pick the child with the most visits.
-    NodePtr bestChild = NULL;
-    int maxVisits = -1;
+    long long blocksReleased() const { return releasedBlocks.load(); }
+    long long bytesReleased() const { return releasedBytes.load(); }
 
-    for (size_t i = 0; i < root->children.size(); ++i) {
-        NodePtr child = root->children[i];
-        if (child->N > maxVisits) {
-            maxVisits = child->N;
-            bestChild = child;
+private:
+    void run() {
+#ifdef __linux__
+        // Only run when nothing else wants the CPU: idle time, not move time.
+        sched_param idle = {};
+        pthread_setschedparam(pthread_self(), SCHED_IDLE, &idle);
+#endif
+        unique_lock<mutex> lock(queueMutex);
+        while (true) {
+            wakeup.wait(lock, [this]() { return stopping || !queue.empty(); });
+            if (queue.empty()) {
+                return; // stopping
+            }
+            vector<LargeAllocation> batch;
+            batch.swap(queue);
+            busy = true;
+            lock.unlock();
+            for (size_t i = 0; i < batch.size(); ++i) {
+                releaseLarge(batch[i]);
+                releasedBlocks++;
+                releasedBytes += static_cast<long long>(batch[i].bytes);
+            }
+            lock.lock();
+            busy = false;
+            drained.notify_all();
         }
     }
 
-    Move bestMove = make_pair(-1, -1);
-    if (bestChild != NULL) {
-        bestMove = bestChild->lastMove;
-    }
+    mutex queueMutex;
+    condition_variable wakeup;
+    condition_variable drained;
+    vector<LargeAllocation> queue;
+    thread worker;
+    bool stopping;
+    bool busy;     // the worker is releasing a batch outside the lock
+    atomic<long long> releasedBlocks;
+    atomic<long long> releasedBytes;
+};
 
-    delete root; // this also deletes the entire tree.
-    return bestMove;
+ArenaReaper& getArenaReaper() {
+    static ArenaReaper reaper;
+    return reaper;
 }
 
 /**
- * Wrapper for computer’s MCTS move.
+ * Release a block from allocateLarge, on the reaper thread if it is big
+ * enough to be worth it.
  */
-void mctsMove(int iterations) {
-    cout << "Computer is thinking (MCTS with " << iterations
-         << " simulations)..." << endl;
-
-    Move bestMove = runMCTS(board, iterations);
-
-    if (bestMove.first != -1) {
-        board[bestMove.first][bestMove.second] = COMPUTER;
-        computerMoves.push_back(bestMove);
+void releaseLargeDeferred(const LargeAllocation& block) {
+    if (block.memory == NULL) {
+        return;
+    }
+    if (deferLargeReleases && block.bytes >= DEFERRED_RELEASE_MIN_BYTES) {
+        getArenaReaper().release(block);
     } else {
-        cout << "Error: MCTS could not find a valid move." << endl;
+        releaseLarge(block);
     }
 }
 
 // ===============================
-// MINIMAX IMPLEMENTATION (HARD)
+// ENGINE OPTIONS
 // ===============================
 
 /**
- * Minimax with alpha-beta pruning.
- * Returns:
- *   +10 if COMPUTER is winning
- *   -10 if PLAYER is winning
- *    0  for draw or equal outcome
+ * Knobs for the MCTS engine, set from the command line.
  */
-int minimax(char currentBoard[BOARD_SIZE][BOARD_SIZE],
-            int depth,
-            bool isMaximizing,
-            int alpha,
-            int beta)
-{
-    char winner = checkWinner(currentBoard);
+struct MctsOptions {
+    int leafParallelRollouts; // rollouts per expanded leaf (1 = single-threaded)
+    int timeBudgetMs;         // if > 0, search for this long instead of N iterations
+    const char* dumpTreePath; // if set, append a snapshot of every search tree here
+    int dumpTreeDepth;        // levels below the root to dump (0 = whole tree)
+    bool expandAll;           // create all children of a node at once, as one block
+    int exactLeafEmpty;       // solve leaves with at most this many empty cells exactly
+    int rolloutPlies;         // plies of minimax before each rollout move (0 = random)
+};
 
-    if (winner == COMPUTER) return 10;
-    if (winner == PLAYER)   return -10;
-    if (winner == 'D')      return 0;
+MctsOptions mctsOptions = { 1, 0, NULL, 0, false, 0, 0 };
+
+// ===============================
+// TASK POOL (WORK STEALING)
+// ===============================
 
-    if (isMaximizing) {
-        int bestScore = INT_MIN;
+/**
+ * Work-stealing task pool shared by every engine and tool.
+ *
+ * Each worker owns a deque: it pushes and pops its own tasks at the back
+ * (LIFO, so nested forks stay cache-warm) and, when empty, steals from the
+ * front of another worker's deque.
+ *
+ * Fork/join goes through TaskGroup. A thread waiting on a group runs the
+ * group's own queued tasks instead of blocking, so a search that forks from
+ * inside a pool task neither deadlocks nor starts extra threads. Unrelated
+ * tasks are left to the workers; running them from inside a wait would stack
+ * one search on top of another without bound.
+ */
+class TaskPool {
+public:
+    typedef function<void()> Task;
 
-        // COMPUTER's turn: try all moves.
-        for (int i = 0; i < BOARD_SIZE; ++i) {
-            for (int j = 0; j < BOARD_SIZE; ++j) {
-                if (currentBoard[i][j] == ' ') {
-                    currentBoard[i][j] = COMPUTER;
-                    int score = minimax(currentBoard, depth + 1, false, alpha, beta);
-                    currentBoard[i][j] = ' ';
+    explicit TaskPool(int threadCount)
+        : pendingTasks(0), nextQueue(0), stopping(false)
+    {
+        threadCount = max(1, threadCount);
+        for (int i = 0; i < threadCount; ++i) {
+            queues.push_back(new WorkerQueue());
+        }
+        for (int i = 0; i < threadCount; ++i) {
+            workers.push_back(thread(&TaskPool::workerLoop, this, i));
+        }
+    }
 
-                    bestScore = max(bestScore, score);
-                    alpha = max(alpha, score);
+    ~TaskPool() {
+        {
+            lock_guard<mutex> lock(sleepMutex);
+            stopping = true;
+        }
+        workAvailable.notify_all();
+        for (size_t i = 0; i < workers.size(); ++i) {
+            workers[i].join();
+        }
+        for (size_t i = 0; i < queues.size(); ++i) {
+            delete queues[i];
+        }
+    }
 
-                    if (beta <= alpha) {
-                        // Cut off branch.
-                        return bestScore;
-                    }
-                }
-            }
+    /**
+     * Queue a task. A worker pushes onto its own deque and an outside
+     * thread spreads tasks round-robin. `owner` tags the task for
+     * runPendingTask (a TaskGroup passes itself).
+     */
+    void submit(const Task& task, const void* owner = NULL) {
+        int target = (currentPool == this) ? currentIndex
+                                           : static_cast<int>(nextQueue++ % queues.size());
+        {
+            lock_guard<mutex> lock(queues[target]->lock);
+            queues[target]->tasks.push_back(QueuedTask(task, owner));
         }
-        return bestScore;
-    } else {
-        int bestScore = INT_MAX;
+        pendingTasks++;
+        {
+            // Taking the lock orders this wakeup after any sleeper's check.
+            lock_guard<mutex> lock(sleepMutex);
+        }
+        workAvailable.notify_one();
+    }
 
-        // PLAYER's turn: try all moves.
-        for (int i = 0; i < BOARD_SIZE; ++i) {
-            for (int j = 0; j < BOARD_SIZE; ++j) {
-                if (currentBoard[i][j] == ' ') {
-                    currentBoard[i][j] = PLAYER;
-                    int score = minimax(currentBoard, depth + 1, true, alpha, beta);
-                    currentBoard[i][j] = ' ';
+    /**
+     * Run one queued task on the calling thread, if there is one; with an
+     * `owner`, only a task submitted for that owner. Workers prefer their
+     * own deque; everyone else only steals.
+     */
+    bool runPendingTask(const void* owner = NULL) {
+        Task task;
+        int self = (currentPool == this) ? currentIndex : -1;
+        if ((self >= 0 && popLocal(self, owner, task)) || steal(self, owner, task)) {
+            task();
+            return true;
+        }
+        return false;
+    }
 
-                    bestScore = min(bestScore, score);
-                    beta = min(beta, score);
+    int size() const {
+        return static_cast<int>(workers.size());
+    }
 
-                    if (beta <= alpha) {
-                        // Cut off branch.
-                        return bestScore;
-                    }
+private:
+    struct QueuedTask {
+        Task task;
+        const void* owner;
+
+        QueuedTask(const Task& t, const void* o) : task(t), owner(o) {}
+    };
+
+    struct WorkerQueue {
+        mutex lock;
+        deque<QueuedTask> tasks;
+    };
+
+    bool popLocal(int index, const void* owner, Task& out) {
+        WorkerQueue& queue = *queues[index];
+        lock_guard<mutex> lock(queue.lock);
+        for (size_t k = queue.tasks.size(); k > 0; --k) {
+            if (owner == NULL || queue.tasks[k - 1].owner == owner) {
+                out = queue.tasks[k - 1].task;
+                queue.tasks.erase(queue.tasks.begin() + (k - 1));
+                pendingTasks--;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool steal(int thief, const void* owner, Task& out) {
+        if (pendingTasks.load() == 0) {
+            return false;
+        }
+        const int count = static_cast<int>(queues.size());
+        const int start = (thief >= 0) ? thief + 1 : 0;
+        for (int k = 0; k < count; ++k) {
+            int victim = (start + k) % count;
+            if (victim == thief) {
+                continue;
+            }
+            WorkerQueue& queue = *queues[victim];
+            lock_guard<mutex> lock(queue.lock);
+            for (size_t k = 0; k < queue.tasks.size(); ++k) {
+                if (owner == NULL || queue.tasks[k].owner == owner) {
+                    out = queue.tasks[k].task;
+                    queue.tasks.erase(queue.tasks.begin() + k);
+                    pendingTasks--;
+                    return true;
                 }
             }
         }
-        return bestScore;
+        return false;
     }
-}
+
+    void workerLoop(int index) {
+        currentPool = this;
+        currentIndex = index;
+
+        while (true) {
+            if (runPendingTask()) {
+                continue;
+            }
+            unique_lock<mutex> lock(sleepMutex);
+            while (!stopping && pendingTasks.load() == 0) {
+                workAvailable.wait(lock);
+            }
+            if (stopping && pendingTasks.load() == 0) {
+                return;
+            }
+        }
+    }
+
+    static thread_local TaskPool* currentPool;
+    static thread_local int currentIndex;
+
+    vector<WorkerQueue*> queues;
+    vector<thread> workers;
+    atomic<int> pendingTasks;
+    atomic<unsigned> nextQueue;
+    mutex sleepMutex;
+    condition_variable workAvailable;
+    bool stopping;
+};
+
+thread_local TaskPool* TaskPool::currentPool = NULL;
+thread_local int TaskPool::currentIndex = -1;
 
 /**
- * Use minimax to choose and play the best possible move for the computer.
+ * Fork/join scope on a TaskPool: run() forks, wait() joins. The destructor
+ * joins too, so tasks never outlive the locals they capture.
  */
-void minimaxMove() {
-    cout << "Computer thinking..." << endl;
+class TaskGroup {
+public:
+    explicit TaskGroup(TaskPool& p) : pool(p), outstanding(0) {}
 
-    int bestScore = INT_MIN;
-    Move bestMove = make_pair(-1, -1);
+    ~TaskGroup() {
+        wait();
+    }
 
-    // Try all possible moves.
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        for (int j = 0; j < BOARD_SIZE; ++j) {
-            if (board[i][j] == ' ') {
-                board[i][j] = COMPUTER;
-                int score = minimax(board, 0, false, INT_MIN, INT_MAX);
-                board[i][j] = ' ';
+    void run(const function<void()>& task) {
+        outstanding++;
+        pool.submit([this, task]() {
+            task();
+            lock_guard<mutex> lock(doneMutex);
+            if (--outstanding == 0) {
+                allDone.notify_all();
+            }
+        }, this);
+    }
 
-                if (score > bestScore) {
-                    bestScore = score;
-                    bestMove = make_pair(i, j);
-                }
+    void wait() {
+        while (outstanding.load() > 0) {
+            if (pool.runPendingTask(this)) {
+                continue;
+            }
+            // Our remaining tasks are running elsewhere; nap until they finish.
+            unique_lock<mutex> lock(doneMutex);
+            if (outstanding.load() > 0) {
+                allDone.wait_for(lock, chrono::microseconds(200));
             }
         }
+        // The last task may still be inside its notify; don't let the group
+        // be destroyed until it has let go of the mutex.
+        lock_guard<mutex> lock(doneMutex);
     }
 
-    if (bestMove.first != -1) {
-        board[bestMove.first][bestMove.second] = COMPUTER;
-        computerMoves.push_back(bestMove);
+private:
+    TaskPool& pool;
+    atomic<int> outstanding;
+    mutex doneMutex;
+    condition_variable allDone;
+};
+
+// Worker count for the shared pool; 0 means one per extra core (the thread
+// that joins a TaskGroup does work too).
+int engineThreads = 0;
+
+/**
+ * The pool shared by all engines and tools, created on first use.
+ */
+TaskPool& getTaskPool() {
+    static TaskPool pool(engineThreads > 0
+                             ? engineThreads
+                             : static_cast<int>(thread::hardware_concurrency()) - 1);
+    return pool;
+}
+
+// ===============================
+// SEARCH TELEMETRY
+// ===============================
+
+/**
+ * One record per engine move, written as a JSON line to the telemetry sink.
+ */
+struct SearchTelemetry {
+    const char* engine;     // "mcts", "minimax" or "random"
+    long long iterations;   // MCTS iterations / minimax positions searched
+    long long simulations;  // rollouts (MCTS) or positions searched (minimax)
+    long long nodes;        // tree nodes allocated (MCTS) or positions visited (minimax)
+    int       maxDepth;     // deepest tree node / recursion depth reached
+    long long treeBytes;    // memory held by the search tree at the end of the search
+    long long elapsedUs;    // wall time of the search
+    Move      move;         // chosen move, (-1,-1) if none
+    double    visitShare;   // chosen child's share of root visits, < 0 if not MCTS
+    PositionKey position;   // position searched
+};
+
+// Where telemetry goes; NULL disables it.
+ostream* telemetrySink = NULL;
+mutex telemetryMutex;
+
+/**
+ * Open the telemetry sink: "-" means stderr, anything else is a file we append to.
+ */
+bool openTelemetrySink(const char* path) {
+    if (strcmp(path, "-") == 0) {
+        telemetrySink = &cerr;
+        return true;
+    }
+    ofstream* file = new ofstream(path, ios::app);
+    if (!*file) {
+        delete file;
+        return false;
+    }
+    telemetrySink = file;
+    return true;
+}
+
+/**
+ * Write one telemetry record. The line is built first and written in one
+ * go so records from concurrent searches never interleave.
+ */
+void emitTelemetry(const SearchTelemetry& t) {
+    if (telemetrySink == NULL) {
+        return;
+    }
+
+    long long timestampMs = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    double seconds = t.elapsedUs / 1e6;
+    long long simsPerSecond = seconds > 0 ? static_cast<long long>(t.simulations / seconds) : 0;
+
+    ostringstream line;
+    line << "{\"ts_ms\":" << timestampMs
+         << ",\"engine\":\"" << t.engine << "\""
+         << ",\"position\":" << t.position.code
+         << ",\"iterations\":" << t.iterations
+         << ",\"nodes\":" << t.nodes
+         << ",\"max_depth\":" << t.maxDepth
+         << ",\"tree_bytes\":" << t.treeBytes
+         << ",\"elapsed_us\":" << t.elapsedUs
+         << ",\"sims_per_sec\":" << simsPerSecond
+         << ",\"move\":[" << t.move.first << "," << t.move.second << "]"
+         << ",\"visit_share\":";
+    if (t.visitShare >= 0) {
+        line << fixed << setprecision(4) << t.visitShare;
     } else {
-        cout << "Error: could not find a valid move." << endl;
+        line << "null";
     }
+    line << "}\n";
+
+    lock_guard<mutex> lock(telemetryMutex);
+    *telemetrySink << line.str();
+    telemetrySink->flush();
+}
+
+/**
+ * Microseconds elapsed since `start`.
+ */
+long long elapsedMicros(chrono::steady_clock::time_point start) {
+    return chrono::duration_cast<chrono::microseconds>(
+        chrono::steady_clock::now() - start).count();
 }
 
 // ===============================
-// BASIC BOARD / GAME FUNCTIONS
+// GAME LOG
 // ===============================
 
-void resetBoard() {
+/**
+ * One finished game, small and fixed-size so it can sit in the log queue.
+ */
+struct GameRecord {
+    long long timestampMs;
+    char xPlayer;           // 'P' human, 'R' random, ...
+    char oPlayer;           // 'P' human, or the computer difficulty
+    char winner;            // 'X', 'O', 'D', or '?' if abandoned
+    unsigned char moveCount;
+    unsigned char moves[BOARD_SIZE * BOARD_SIZE]; // cells in play order, X first
+};
+
+/**
+ * When the log writer calls fsync.
+ */
+enum FsyncPolicy {
+    FSYNC_NEVER,    // leave it to the OS
+    FSYNC_BATCH,    // after every batch write
+    FSYNC_INTERVAL  // at most every fsyncIntervalMs
+};
+
+/**
+ * Asynchronous game log. Game threads push records onto a bounded
+ * lock-free multi-producer/single-consumer ring (Vyukov's per-slot sequence
+ * scheme); one writer thread drains it, formats records into a large buffer
+ * and writes it out in big sequential writes.
+ *
+ * Producers never block on I/O. If the ring is full they yield until
+ * there is room, and each such wait is counted as back-pressure.
+ *
+ * On Unix the writer uses a raw file descriptor and fsync; elsewhere it
+ * falls back to stdio, where "fsync" is only an fflush.
+ *
+ * File format: one line per game,
+ *   <unix ms> <X player> <O player> <winner> <moves...>
+ * with moves as row/column digit pairs in play order, e.g.
+ *   1792261299068 P I D 22 11 33 13 12 32 21 23 31
+ */
+class GameLogger {
+public:
+    struct Stats {
+        long long recordsLogged;
+        long long recordsWritten;
+        long long bytesWritten;
+        long long batches;
+        long long fsyncs;
+        long long backpressureWaits; // producer spins on a full ring
+        long long queueHighWater;
+    };
+
+#ifdef __unix__
+    typedef int FileHandle;   // file descriptor
+#else
+    typedef FILE* FileHandle;
+#endif
+
+    GameLogger(FileHandle file, FsyncPolicy policy, int fsyncIntervalMs)
+        : file(file), policy(policy), fsyncIntervalMs(fsyncIntervalMs),
+          slots(new Slot[RING_SIZE]), enqueuePos(0), dequeuePos(0), stopping(false),
+          recordsLogged(0), backpressureWaits(0), queueHighWater(0),
+          recordsWritten(0), bytesWritten(0), batches(0), fsyncs(0)
+    {
+        for (size_t i = 0; i < RING_SIZE; ++i) {
+            slots[i].sequence.store(i, memory_order_relaxed);
+        }
+        writer = thread(&GameLogger::writerLoop, this);
+    }
+
+    ~GameLogger() {
+        close();
+        delete[] slots;
+    }
+
+    /**
+     * Open PATH for appending and start the writer thread. NULL on failure.
+     */
+    static GameLogger* open(const char* path, FsyncPolicy policy, int fsyncIntervalMs) {
+#ifdef __unix__
+        FileHandle file = ::open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+        if (file < 0) {
+            return NULL;
+        }
+#else
+        FileHandle file = fopen(path, "ab");
+        if (file == NULL) {
+            return NULL;
+        }
+#endif
+        return new GameLogger(file, policy, fsyncIntervalMs);
+    }
+
+    /**
+     * Queue a record. Called from any game thread.
+     */
+    void log(const GameRecord& record) {
+        size_t pos = enqueuePos.load(memory_order_relaxed);
+        Slot* slot;
+        while (true) {
+            slot = &slots[pos & (RING_SIZE - 1)];
+            size_t sequence = slot->sequence.load(memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(pos);
+            if (diff == 0) {
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                    break;
+                }
+            } else if (diff < 0) {
+                // Ring full: the writer is behind.
+                backpressureWaits.fetch_add(1, memory_order_relaxed);
+                this_thread::yield();
+                pos = enqueuePos.load(memory_order_relaxed);
+            } else {
+                pos = enqueuePos.load(memory_order_relaxed);
+            }
+        }
+        slot->record = record;
+        slot->sequence.store(pos + 1, memory_order_release);
+
+        recordsLogged.fetch_add(1, memory_order_relaxed);
+        long long depth = static_cast<long long>(pos + 1 - dequeuePos.load(memory_order_relaxed));
+        long long high = queueHighWater.load(memory_order_relaxed);
+        while (depth > high &&
+               !queueHighWater.compare_exchange_weak(high, depth, memory_order_relaxed)) {
+        }
+    }
+
+    /**
+     * Drain everything queued so far, write it out and stop the writer.
+     */
+    void close() {
+        if (writer.joinable()) {
+            stopping = true;
+            writer.join();
+            if (policy != FSYNC_NEVER) {
+                syncFile();
+            }
+#ifdef __unix__
+            ::close(file);
+#else
+            fclose(file);
+#endif
+        }
+    }
+
+    Stats stats() const {
+        Stats s = { recordsLogged.load(), recordsWritten.load(), bytesWritten.load(),
+                    batches.load(), fsyncs.load(), backpressureWaits.load(),
+                    queueHighWater.load() };
+        return s;
+    }
+
+private:
+    static const size_t RING_SIZE = 1 << 16;     // records; must be a power of two
+    static const size_t BATCH_BYTES = 256 * 1024;
+
+    struct Slot {
+        atomic<size_t> sequence;
+        GameRecord record;
+    };
+
+    /**
+     * Single consumer: take the next record if one is ready.
+     */
+    bool pop(GameRecord& out) {
+        size_t pos = dequeuePos.load(memory_order_relaxed);
+        Slot& slot = slots[pos & (RING_SIZE - 1)];
+        if (slot.sequence.load(memory_order_acquire) != pos + 1) {
+            return false;
+        }
+        out = slot.record;
+        slot.sequence.store(pos + RING_SIZE, memory_order_release);
+        dequeuePos.store(pos + 1, memory_order_relaxed);
+        return true;
+    }
+
+    static void appendRecord(string& out, const GameRecord& r) {
+        char number[24];
+        char* end = to_chars(number, number + sizeof(number), r.timestampMs).ptr;
+        out.append(number, end);
+        out += ' ';
+        out += r.xPlayer;
+        out += ' ';
+        out += r.oPlayer;
+        out += ' ';
+        out += r.winner;
+        for (int i = 0; i < r.moveCount; ++i) {
+            out += ' ';
+            out += static_cast<char>('1' + r.moves[i] / BOARD_SIZE);
+            out += static_cast<char>('1' + r.moves[i] % BOARD_SIZE);
+        }
+        out += '\n';
+    }
+
+    void syncFile() {
+#ifdef __unix__
+        fsync(file);
+#else
+        fflush(file);
+#endif
+        fsyncs++;
+    }
+
+    void writeBatch(string& batch) {
+        const char* data = batch.data();
+        size_t left = batch.size();
+#ifdef __unix__
+        while (left > 0) {
+            ssize_t written = write(file, data, left);
+            if (written <= 0) {
+                break; // disk full or similar; drop the batch rather than spin
+            }
+            data += written;
+            left -= static_cast<size_t>(written);
+        }
+#else
+        left -= fwrite(data, 1, left, file);
+        fflush(file);
+#endif
+        bytesWritten += static_cast<long long>(batch.size() - left);
+        batches++;
+        batch.clear();
+
+        if (policy == FSYNC_BATCH) {
+            syncFile();
+        } else if (policy == FSYNC_INTERVAL &&
+                   chrono::steady_clock::now() - lastFsync >= chrono::milliseconds(fsyncIntervalMs)) {
+            syncFile();
+            lastFsync = chrono::steady_clock::now();
+        }
+    }
+
+    void writerLoop() {
+        string batch;
+        batch.reserve(BATCH_BYTES + 128);
+        lastFsync = chrono::steady_clock::now();
+
+        while (true) {
+            bool wasStopping = stopping.load();
+            GameRecord record;
+            long long drained = 0;
+            while (batch.size() < BATCH_BYTES && pop(record)) {
+                appendRecord(batch, record);
+                drained++;
+            }
+            recordsWritten += drained;
+
+            if (batch.size() >= BATCH_BYTES) {
+                writeBatch(batch);
+                continue;
+            }
+            if (drained == 0) {
+                // Queue is empty: flush what we have and nap briefly.
+                if (!batch.empty()) {
+                    writeBatch(batch);
+                }
+                if (wasStopping) {
+                    return;
+                }
+                this_thread::sleep_for(chrono::milliseconds(2));
+            }
+        }
+    }
+
+    FileHandle file;
+    FsyncPolicy policy;
+    int fsyncIntervalMs;
+    chrono::steady_clock::time_point lastFsync;
+
+    Slot* slots;
+    atomic<size_t> enqueuePos;
+    atomic<size_t> dequeuePos;
+    atomic<bool> stopping;
+    thread writer;
+
+    atomic<long long> recordsLogged;
+    atomic<long long> backpressureWaits;
+    atomic<long long> queueHighWater;
+    atomic<long long> recordsWritten;
+    atomic<long long> bytesWritten;
+    atomic<long long> batches;
+    atomic<long long> fsyncs;
+};
+
+// The process-wide game log; NULL unless --log-games is given.
+GameLogger* gameLogger = NULL;
+
+/**
+ * Build a record from a board's move sequence (cells in play order).
+ */
+GameRecord makeGameRecord(char xPlayer, char oPlayer, char winner,
+                          const unsigned char* moves, int moveCount) {
+    GameRecord record;
+    record.timestampMs = chrono::duration_cast<chrono::milliseconds>(
+        chrono::system_clock::now().time_since_epoch()).count();
+    record.xPlayer = xPlayer;
+    record.oPlayer = oPlayer;
+    record.winner = (winner == ' ') ? '?' : winner;
+    record.moveCount = static_cast<unsigned char>(moveCount);
+    memcpy(record.moves, moves, moveCount);
+    return record;
+}
+
+// ===============================
+// MCTS STRUCT AND FUNCTIONS
+// ===============================
+
+// Arena index meaning "no node".
+const uint32_t NO_NODE = 0xFFFFFFFFu;
+// Move of the root, which no move led to.
+const uint8_t NO_MOVE = 0xFF;
+
+// MCTSNode flags.
+const uint8_t NODE_TERMINAL     = 1; // game over at this node
+const uint8_t NODE_COMPUTER_WIN = 2; // ...and COMPUTER won
+const uint8_t NODE_PLAYER_WIN   = 4; // ...and PLAYER won
+const uint8_t NODE_CHILD_BLOCK  = 8; // children are contiguous: firstChild + 0..childCount-1
+const uint8_t NODE_PENDING      = 16; // created in a block; flags/untried not worked out yet
+
+/**
+ * Node in the Monte Carlo Tree. Nodes live in an MctsTree arena and link
+ * by index; the board isn't stored but rebuilt by applying moves from the
+ * root as selection walks down, and whose turn it is follows from the
+ * depth (COMPUTER moves at the root). Children form a singly linked list
+ * in expansion order. Moves not yet expanded are a bitmask over cells, so
+ * "fully expanded" is `untried == 0`.
+ */
+struct MCTSNode {
+    int W;                // number of simulations that resulted in a COMPUTER win
+    int N;                // number of times this node was visited
+    uint32_t firstChild;  // arena index of the first child, NO_NODE if none
+    uint32_t nextSibling; // next child of the same parent, NO_NODE if last
+    uint8_t move;         // cell (row * 3 + column) that led here, NO_MOVE at the root
+    uint8_t childCount;
+    uint8_t flags;        // NODE_* bits, set when the node is created
+    uint16_t untried;     // bit per cell we haven't expanded yet; 0 when terminal
+};
+
+static_assert(sizeof(MCTSNode) <= 24, "MCTS nodes should stay within 24 bytes");
+
+/**
+ * Flags for a freshly created node from the board it stands for.
+ */
+uint8_t nodeFlagsFor(const char b[BOARD_SIZE][BOARD_SIZE]) {
+    char winner = checkWinner(b);
+    if (winner == ' ') return 0;
+    if (winner == COMPUTER) return NODE_TERMINAL | NODE_COMPUTER_WIN;
+    if (winner == PLAYER) return NODE_TERMINAL | NODE_PLAYER_WIN;
+    return NODE_TERMINAL;
+}
+
+/**
+ * Bit per empty cell (row * 3 + column) of a position that is still in
+ * play, 0 once the game is over: the moves a new node has left to expand.
+ */
+uint16_t untriedMovesFor(const char b[BOARD_SIZE][BOARD_SIZE], uint8_t flags) {
+    if (flags & NODE_TERMINAL) {
+        return 0;
+    }
+    uint16_t mask = 0;
+    for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE; ++cell) {
+        if (b[cell / BOARD_SIZE][cell % BOARD_SIZE] == ' ') {
+            mask |= 1 << cell;
+        }
+    }
+    return mask;
+}
+
+/**
+ * One search tree: the root position and a growable arena of nodes, the
+ * root at index 0. The arena comes from allocateLarge, so big trees get
+ * huge pages, and the whole tree is released in one go, without walking
+ * it, on the reaper thread when it is large. Growing moves the
+ * nodes, so hold indices, not references, across allocate().
+ */
+class MctsTree {
+public:
+    MctsTree(const char board[BOARD_SIZE][BOARD_SIZE], size_t capacityHint)
+        : count(0), capacity(0), nodes(NULL) {
+        memcpy(rootBoard, board, sizeof(rootBoard));
+        arena.memory = NULL;
+        reserve(max<size_t>(capacityHint, 16));
+        uint32_t root = allocate();
+        nodes[root].flags = nodeFlagsFor(board);
+        nodes[root].untried = untriedMovesFor(board, nodes[root].flags);
+    }
+
+    ~MctsTree() {
+        releaseLargeDeferred(arena);
+    }
+
+    MCTSNode& node(uint32_t index) { return nodes[index]; }
+    const MCTSNode& node(uint32_t index) const { return nodes[index]; }
+
+    /** A new, unlinked node with no statistics. */
+    uint32_t allocate() {
+        if (count == capacity) {
+            reserve(capacity * 2);
+        }
+        MCTSNode& n = nodes[count];
+        n.W = 0;
+        n.N = 0;
+        n.firstChild = NO_NODE;
+        n.nextSibling = NO_NODE;
+        n.move = NO_MOVE;
+        n.childCount = 0;
+        n.flags = 0;
+        n.untried = 0;
+        return count++;
+    }
+
+    /**
+     * `n` new nodes at consecutive indices, linked as siblings in order.
+     * Returns the first index.
+     */
+    uint32_t allocateBlock(int n) {
+        while (count + n > capacity) {
+            reserve(capacity * 2);
+        }
+        uint32_t first = count;
+        for (int k = 0; k < n; ++k) {
+            allocate();
+            nodes[first + k].nextSibling = (k + 1 < n) ? first + k + 1 : NO_NODE;
+        }
+        return first;
+    }
+
+    uint32_t size() const { return count; }
+
+    /** Bytes held by the arena. */
+    size_t bytes() const { return capacity * sizeof(MCTSNode); }
+
+    /** Side to move at `depth` below the root. */
+    static char playerAt(int depth) { return (depth % 2 == 0) ? COMPUTER : PLAYER; }
+
+    char rootBoard[BOARD_SIZE][BOARD_SIZE];
+
+private:
+    MctsTree(const MctsTree&);
+    MctsTree& operator=(const MctsTree&);
+
+    void reserve(size_t newCapacity) {
+        LargeAllocation grown = allocateLarge(newCapacity * sizeof(MCTSNode));
+        if (count > 0) {
+            memcpy(grown.memory, nodes, count * sizeof(MCTSNode));
+        }
+        releaseLargeDeferred(arena);
+        arena = grown;
+        nodes = static_cast<MCTSNode*>(grown.memory);
+        capacity = static_cast<uint32_t>(grown.bytes / sizeof(MCTSNode));
+    }
+
+    uint32_t count;
+    uint32_t capacity;
+    MCTSNode* nodes;
+    LargeAllocation arena;
+};
+
+/**
+ * Calculate UCT (Upper Confidence Bound for Trees) for a child node.
+ * This balances:
+ *   - exploitation: how good this node has been so far
+ *   - exploration: how much we still need to try it
+ */
+double calculateUCT(const MCTSNode& node, int parentVisits) {
+    const double C = 1.414; // exploration constant ~ sqrt(2)
+    if (node.N == 0) {
+        // If node was never visited, treat it as extremely promising.
+        return INT_MAX;
+    }
+    double winRate     = static_cast<double>(node.W) / node.N;
+    double exploration = C * sqrt(log(static_cast<double>(parentVisits)) / node.N);
+    return winRate + exploration;
+}
+
+/**
+ * Among all children of `parent`, pick the one with the highest UCT value.
+ * Returns NO_NODE if it has none.
+ */
+uint32_t selectBestChild(const MctsTree& tree, uint32_t parent) {
+    uint32_t bestChild = NO_NODE;
+    double bestUCT = -1.0;
+    const int parentVisits = tree.node(parent).N;
+
+    if (tree.node(parent).flags & NODE_CHILD_BLOCK) {
+        // Dense block: a linear scan the prefetcher can follow.
+        const uint32_t first = tree.node(parent).firstChild;
+        const uint32_t end = first + tree.node(parent).childCount;
+        for (uint32_t child = first; child < end; ++child) {
+            double uct = calculateUCT(tree.node(child), parentVisits);
+            if (uct > bestUCT) {
+                bestUCT = uct;
+                bestChild = child;
+            }
+        }
+        return bestChild;
+    }
+
+    for (uint32_t child = tree.node(parent).firstChild; child != NO_NODE;
+         child = tree.node(child).nextSibling) {
+        double uct = calculateUCT(tree.node(child), parentVisits);
+
+        if (uct > bestUCT) {
+            bestUCT = uct;
+            bestChild = child;
+        }
+    }
+    return bestChild;
+}
+
+/**
+ * Expand `parent`, whose position is `b` with `mover` to play, by one
+ * untried move: the highest cell left in its untried mask. The move is
+ * applied to `b` and the new child's index returned.
+ */
+uint32_t expandNode(MctsTree& tree, uint32_t parent,
+                    char b[BOARD_SIZE][BOARD_SIZE], char mover) {
+    MCTSNode& expanding = tree.node(parent);
+    int cell = 31 - __builtin_clz(expanding.untried);
+    expanding.untried &= ~(1u << cell);
+
+    // Apply the move for the current player.
+    b[cell / BOARD_SIZE][cell % BOARD_SIZE] = mover;
+
+    uint32_t child = tree.allocate(); // may move the nodes: no references across this
+    MCTSNode& created = tree.node(child);
+    created.move = static_cast<uint8_t>(cell);
+    created.flags = nodeFlagsFor(b);
+    created.untried = untriedMovesFor(b, created.flags);
+
+    // Link at the end so children stay in expansion order.
+    uint32_t last = tree.node(parent).firstChild;
+    if (last == NO_NODE) {
+        tree.node(parent).firstChild = child;
+    } else {
+        while (tree.node(last).nextSibling != NO_NODE) {
+            last = tree.node(last).nextSibling;
+        }
+        tree.node(last).nextSibling = child;
+    }
+    tree.node(parent).childCount++;
+    return child;
+}
+
+/**
+ * Work out the flags and untried moves of a node created by
+ * expandAllChildren, now that selection has reached it with its
+ * position in `b`.
+ */
+void resolvePendingNode(MctsTree& tree, uint32_t index, const char b[BOARD_SIZE][BOARD_SIZE]) {
+    MCTSNode& n = tree.node(index);
+    n.flags = nodeFlagsFor(b);
+    n.untried = untriedMovesFor(b, n.flags);
+}
+
+/**
+ * Expand `parent` (position `b`, `mover` to play) by creating a child for
+ * every untried move at once, as one contiguous block in the arena, in
+ * the same order expandNode would add them. Only the block's first child
+ * is worked out now; the others are marked pending and resolved when
+ * selection first steps into them. The first child's move is applied to
+ * `b` and its index returned.
+ */
+uint32_t expandAllChildren(MctsTree& tree, uint32_t parent,
+                           char b[BOARD_SIZE][BOARD_SIZE], char mover) {
+    uint16_t untried = tree.node(parent).untried;
+    const int n = __builtin_popcount(untried);
+    uint32_t first = tree.allocateBlock(n); // may move the nodes
+    for (int k = 0; k < n; ++k) {
+        int cell = 31 - __builtin_clz(untried);
+        untried &= ~(1u << cell);
+        tree.node(first + k).move = static_cast<uint8_t>(cell);
+        tree.node(first + k).flags = NODE_PENDING;
+    }
+
+    MCTSNode& expanded = tree.node(parent);
+    expanded.firstChild = first;
+    expanded.childCount = static_cast<uint8_t>(n);
+    expanded.untried = 0;
+    expanded.flags |= NODE_CHILD_BLOCK;
+
+    int cell = tree.node(first).move;
+    b[cell / BOARD_SIZE][cell % BOARD_SIZE] = mover;
+    resolvePendingNode(tree, first, b);
+    return first;
+}
+
+/**
+ * Per-thread random number in [0, n) for rollouts. rand() shares a single
+ * state behind a lock, which would serialise rollouts on worker threads.
+ */
+int rolloutRandom(int n) {
+    static atomic<unsigned> streamCounter(0);
+    thread_local unsigned state = 0;
+    if (state == 0) {
+        // Seed from rand() so srand() still controls the whole program.
+        state = (static_cast<unsigned>(rand()) ^ (++streamCounter * 2654435761u)) | 1u;
+    }
+    // xorshift32
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return static_cast<int>(state % static_cast<unsigned>(n));
+}
+
+/**
+ * Play random moves until the game ends and return:
+ *   10  -> COMPUTER wins
+ *   -10 -> PLAYER wins
+ *    0  -> draw
+ */
+int simulateRandomGame(const char startBoard[BOARD_SIZE][BOARD_SIZE], char playerToMove) {
+    // Work on a temporary copy.
+    char tempBoard[BOARD_SIZE][BOARD_SIZE];
     for (int i = 0; i < BOARD_SIZE; ++i) {
         for (int j = 0; j < BOARD_SIZE; ++j) {
-            board[i][j] = ' ';
+            tempBoard[i][j] = startBoard[i][j];
+        }
+    }
+
+    char currentPlayer = playerToMove;
+
+    while (true) {
+        char winner = checkWinner(tempBoard);
+        if (winner != ' ') {
+            if (winner == COMPUTER) return 10;
+            if (winner == PLAYER)   return -10;
+            return 0; // 'D' draw
+        }
+
+        // Collect all empty spots.
+        vector<Move> freeSpaces;
+        for (int i = 0; i < BOARD_SIZE; ++i) {
+            for (int j = 0; j < BOARD_SIZE; ++j) {
+                if (tempBoard[i][j] == ' ') {
+                    freeSpaces.push_back(make_pair(i, j));
+                }
+            }
+        }
+
+        if (freeSpaces.empty()) {
+            return 0; // No more moves -> draw.
         }
+
+        // Pick a random empty cell.
+        int randomIndex = rolloutRandom(static_cast<int>(freeSpaces.size()));
+        Move randomMove = freeSpaces[randomIndex];
+        tempBoard[randomMove.first][randomMove.second] = currentPlayer;
+
+        // Switch turn.
+        currentPlayer = (currentPlayer == PLAYER ? COMPUTER : PLAYER);
+    }
+}
+
+/**
+ * Shallow minimax for rollouts: +1 if `mover` can force a win within
+ * `plies` plies, -1 if the opponent can, 0 if neither shows up in time.
+ */
+int shallowRolloutSearch(char b[BOARD_SIZE][BOARD_SIZE], char mover, int plies) {
+    if (plies == 0) {
+        return 0;
+    }
+    const char opponent = (mover == PLAYER ? COMPUTER : PLAYER);
+    int best = -2;
+    for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE && best < 1; ++cell) {
+        char& c = b[cell / BOARD_SIZE][cell % BOARD_SIZE];
+        if (c != ' ') {
+            continue;
+        }
+        c = mover;
+        char winner = checkWinner(b);
+        int score = (winner == mover) ? 1
+                  : (winner == 'D')   ? 0
+                                      : -shallowRolloutSearch(b, opponent, plies - 1);
+        c = ' ';
+        best = max(best, score);
+    }
+    return (best == -2) ? 0 : best;
+}
+
+/**
+ * Rollout with a minimax search of `plies` plies before every move
+ * (MCTS-MR): the mover takes a forced win when it sees one, avoids moves
+ * that let the opponent force one, and otherwise plays at random among the
+ * remaining moves. Same result convention as simulateRandomGame.
+ */
+int simulateMinimaxRollout(const char startBoard[BOARD_SIZE][BOARD_SIZE],
+                           char playerToMove, int plies) {
+    char tempBoard[BOARD_SIZE][BOARD_SIZE];
+    memcpy(tempBoard, startBoard, sizeof(tempBoard));
+
+    char currentPlayer = playerToMove;
+    while (true) {
+        char winner = checkWinner(tempBoard);
+        if (winner != ' ') {
+            if (winner == COMPUTER) return 10;
+            if (winner == PLAYER)   return -10;
+            return 0;
+        }
+
+        const char opponent = (currentPlayer == PLAYER ? COMPUTER : PLAYER);
+        int candidates[BOARD_SIZE * BOARD_SIZE];
+        int candidateCount = 0;
+        int bestScore = -2;
+        for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE; ++cell) {
+            char& c = tempBoard[cell / BOARD_SIZE][cell % BOARD_SIZE];
+            if (c != ' ') {
+                continue;
+            }
+            c = currentPlayer;
+            char result = checkWinner(tempBoard);
+            int score = (result == currentPlayer) ? 1
+                      : (result == 'D')           ? 0
+                                                  : -shallowRolloutSearch(tempBoard, opponent, plies - 1);
+            c = ' ';
+            if (score > bestScore) {
+                bestScore = score;
+                candidateCount = 0;
+            }
+            if (score == bestScore) {
+                candidates[candidateCount++] = cell;
+            }
+        }
+
+        int cell = candidates[rolloutRandom(candidateCount)];
+        tempBoard[cell / BOARD_SIZE][cell % BOARD_SIZE] = currentPlayer;
+        currentPlayer = opponent;
+    }
+}
+
+/**
+ * One rollout of the kind selected by mctsOptions.rolloutPlies.
+ */
+int simulateRollout(const char startBoard[BOARD_SIZE][BOARD_SIZE], char playerToMove) {
+    if (mctsOptions.rolloutPlies > 0) {
+        return simulateMinimaxRollout(startBoard, playerToMove, mctsOptions.rolloutPlies);
+    }
+    return simulateRandomGame(startBoard, playerToMove);
+}
+
+/**
+ * Run `count` rollouts from the same position and return how many of them
+ * the COMPUTER won. The rollouts are forked onto the shared task pool; the
+ * calling thread joins and helps run them.
+ */
+int runParallelRollouts(const char startBoard[BOARD_SIZE][BOARD_SIZE],
+                        char playerToMove,
+                        int count)
+{
+    atomic<int> wins(0);
+
+    TaskGroup group(getTaskPool());
+    for (int k = 0; k < count; ++k) {
+        group.run([&]() {
+            if (simulateRollout(startBoard, playerToMove) == 10) {
+                wins++;
+            }
+        });
+    }
+    group.wait();
+
+    return wins.load();
+}
+
+/**
+ * Backpropagate an aggregated batch of simulations along the selection
+ * path (`path[0]` is the root, `path[length - 1]` the leaf):
+ * `visits` simulations of which `wins` were COMPUTER wins.
+ */
+void backpropagateBatch(MctsTree& tree, const uint32_t* path, int length, int wins, int visits) {
+    for (int i = length - 1; i >= 0; --i) {
+        MCTSNode& current = tree.node(path[i]);
+        current.N += visits;
+        current.W += wins;
+    }
+}
+
+// ===============================
+// TREE SNAPSHOTS
+// ===============================
+
+/*
+ * Snapshot file format (little-endian). A file holds any number of
+ * snapshots back to back, one per search:
+ *
+ *   header  "TTTS"  4 bytes magic
+ *           u8      format version (1)
+ *           u8      depth limit used for the dump (0 = whole tree)
+ *           u16     reserved
+ *           u32     node count
+ *           9 bytes root board, row by row (' ', 'X', 'O')
+ *   nodes   node count records of 12 bytes in preorder:
+ *           u8      move as row * 3 + column (0xFF for the root)
+ *           u8      depth (root = 0)
+ *           u8      number of children that follow in the dump
+ *           u8      side to move at this node
+ *           u32     N (visits)
+ *           u32     W (COMPUTER wins)
+ */
+
+const char SNAPSHOT_MAGIC[4] = { 'T', 'T', 'T', 'S' };
+const int  SNAPSHOT_VERSION = 1;
+const int  SNAPSHOT_HEADER_BYTES = 4 + 4 + 4 + BOARD_SIZE * BOARD_SIZE;
+const int  SNAPSHOT_NODE_BYTES = 12;
+
+void putU32(string& out, unsigned value) {
+    for (int i = 0; i < 4; ++i) {
+        out.push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+    }
+}
+
+unsigned getU32(const unsigned char* in) {
+    return in[0] | (in[1] << 8) | (in[2] << 16) | (static_cast<unsigned>(in[3]) << 24);
+}
+
+/**
+ * Append `node` and its descendants (down to depthLimit) in preorder.
+ * Returns the number of records written.
+ */
+unsigned snapshotNodes(const MctsTree& tree, uint32_t index, int depth, int depthLimit, string& out) {
+    const MCTSNode& node = tree.node(index);
+    bool expandChildren = (depthLimit == 0 || depth < depthLimit);
+    int childCount = expandChildren ? node.childCount : 0;
+
+    out.push_back(static_cast<char>(node.move));
+    out.push_back(static_cast<char>(depth));
+    out.push_back(static_cast<char>(childCount));
+    out.push_back(MctsTree::playerAt(depth));
+    putU32(out, static_cast<unsigned>(node.N));
+    putU32(out, static_cast<unsigned>(node.W));
+
+    unsigned written = 1;
+    if (expandChildren) {
+        for (uint32_t child = node.firstChild; child != NO_NODE; child = tree.node(child).nextSibling) {
+            written += snapshotNodes(tree, child, depth + 1, depthLimit, out);
+        }
+    }
+    return written;
+}
+
+/**
+ * Append a snapshot of `tree` to `path`.
+ */
+bool writeTreeSnapshot(const MctsTree& tree, const char* path, int depthLimit) {
+    string nodes;
+    unsigned count = snapshotNodes(tree, 0, 0, depthLimit, nodes);
+
+    string header(SNAPSHOT_MAGIC, 4);
+    header.push_back(static_cast<char>(SNAPSHOT_VERSION));
+    header.push_back(static_cast<char>(depthLimit));
+    header.push_back(0);
+    header.push_back(0);
+    putU32(header, count);
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        for (int j = 0; j < BOARD_SIZE; ++j) {
+            header.push_back(tree.rootBoard[i][j]);
+        }
+    }
+
+    ofstream file(path, ios::binary | ios::app);
+    if (!file) {
+        return false;
+    }
+    file.write(header.data(), header.size());
+    file.write(nodes.data(), nodes.size());
+    return static_cast<bool>(file);
+}
+
+/**
+ * A snapshot node as read back from disk.
+ */
+struct SnapshotNode {
+    int move;       // row * 3 + column, -1 for the root
+    int depth;
+    int childCount;
+    char playerToMove;
+    unsigned N;
+    unsigned W;
+    vector<int> children; // indices into the snapshot's node list
+};
+
+/**
+ * Rebuild child lists from preorder records starting at `index`.
+ * Returns the index after the subtree.
+ */
+size_t linkSnapshotChildren(vector<SnapshotNode>& nodes, size_t index) {
+    size_t next = index + 1;
+    for (int c = 0; c < nodes[index].childCount && next < nodes.size(); ++c) {
+        nodes[index].children.push_back(static_cast<int>(next));
+        next = linkSnapshotChildren(nodes, next);
+    }
+    return next;
+}
+
+/**
+ * Print one snapshot: root position, principal variation (most visited
+ * child at every level) and per-level branching statistics.
+ */
+void printTreeSnapshot(int snapshotIndex, const char rootBoard[BOARD_SIZE * BOARD_SIZE],
+                       int depthLimit, vector<SnapshotNode>& nodes) {
+    linkSnapshotChildren(nodes, 0);
+
+    cout << "Snapshot " << snapshotIndex << ": " << nodes.size() << " nodes";
+    if (depthLimit > 0) {
+        cout << " (top " << depthLimit << " levels)";
+    }
+    cout << "\n";
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        cout << "  ";
+        for (int j = 0; j < BOARD_SIZE; ++j) {
+            char cell = rootBoard[i * BOARD_SIZE + j];
+            cout << (cell == ' ' ? '.' : cell);
+        }
+        cout << "\n";
+    }
+
+    cout << "Principal variation:\n";
+    int current = 0;
+    while (!nodes[current].children.empty()) {
+        int best = nodes[current].children[0];
+        for (size_t c = 1; c < nodes[current].children.size(); ++c) {
+            if (nodes[nodes[current].children[c]].N > nodes[best].N) {
+                best = nodes[current].children[c];
+            }
+        }
+        const SnapshotNode& n = nodes[best];
+        double share = nodes[current].N > 0 ? 100.0 * n.N / nodes[current].N : 0.0;
+        cout << "  " << n.depth << ". " << nodes[current].playerToMove
+             << " (" << n.move / BOARD_SIZE + 1 << "," << n.move % BOARD_SIZE + 1 << ")"
+             << "  N=" << n.N << "  W=" << n.W
+             << "  win=" << fixed << setprecision(3) << (n.N > 0 ? static_cast<double>(n.W) / n.N : 0.0)
+             << "  share=" << setprecision(1) << share << "%\n";
+        current = best;
+    }
+
+    int maxDepth = 0;
+    for (size_t i = 0; i < nodes.size(); ++i) {
+        maxDepth = max(maxDepth, nodes[i].depth);
+    }
+    cout << "Per-level branching:\n";
+    cout << "  " << left << setw(7) << "depth" << setw(9) << "nodes" << setw(10) << "internal"
+         << setw(12) << "branching" << setw(12) << "visits" << "visited once\n";
+    for (int d = 0; d <= maxDepth; ++d) {
+        long long count = 0, internal = 0, children = 0, visits = 0, singles = 0;
+        for (size_t i = 0; i < nodes.size(); ++i) {
+            if (nodes[i].depth != d) continue;
+            count++;
+            visits += nodes[i].N;
+            if (nodes[i].N == 1) singles++;
+            if (!nodes[i].children.empty()) {
+                internal++;
+                children += nodes[i].children.size();
+            }
+        }
+        cout << "  " << setw(7) << d << setw(9) << count << setw(10) << internal
+             << setw(12) << setprecision(2) << (internal > 0 ? static_cast<double>(children) / internal : 0.0)
+             << setw(12) << visits << singles << "\n";
+    }
+    cout << right << "\n";
+}
+
+/**
+ * Read every snapshot in `path` and print it. Returns false on a bad file.
+ */
+bool readTreeSnapshots(const char* path) {
+    ifstream file(path, ios::binary);
+    if (!file) {
+        cout << "Could not open snapshot file: " << path << "\n";
+        return false;
+    }
+    string data((istreambuf_iterator<char>(file)), istreambuf_iterator<char>());
+    const unsigned char* bytes = reinterpret_cast<const unsigned char*>(data.data());
+
+    size_t offset = 0;
+    int snapshotIndex = 0;
+    while (offset < data.size()) {
+        if (data.size() - offset < static_cast<size_t>(SNAPSHOT_HEADER_BYTES) ||
+            memcmp(bytes + offset, SNAPSHOT_MAGIC, 4) != 0 ||
+            bytes[offset + 4] != SNAPSHOT_VERSION) {
+            cout << "Bad snapshot header at byte " << offset << "\n";
+            return false;
+        }
+        int depthLimit = bytes[offset + 5];
+        unsigned count = getU32(bytes + offset + 8);
+        char rootBoard[BOARD_SIZE * BOARD_SIZE];
+        memcpy(rootBoard, bytes + offset + 12, sizeof(rootBoard));
+        offset += SNAPSHOT_HEADER_BYTES;
+
+        if (count == 0 || (data.size() - offset) / SNAPSHOT_NODE_BYTES < count) {
+            cout << "Truncated snapshot " << snapshotIndex << "\n";
+            return false;
+        }
+        vector<SnapshotNode> nodes(count);
+        for (unsigned i = 0; i < count; ++i) {
+            const unsigned char* record = bytes + offset + i * SNAPSHOT_NODE_BYTES;
+            nodes[i].move = (record[0] == 0xFF) ? -1 : record[0];
+            nodes[i].depth = record[1];
+            nodes[i].childCount = record[2];
+            nodes[i].playerToMove = static_cast<char>(record[3]);
+            nodes[i].N = getU32(record + 4);
+            nodes[i].W = getU32(record + 8);
+        }
+        offset += static_cast<size_t>(count) * SNAPSHOT_NODE_BYTES;
+
+        printTreeSnapshot(snapshotIndex++, rootBoard, depthLimit, nodes);
+    }
+    return true;
+}
+
+/**
+ * Counters filled in by runMCTS for callers that want to measure it.
+ */
+struct MctsStats {
+    long long iterations;  // selection/expansion/backprop cycles
+    long long rollouts;    // simulations backed up (K per iteration in leaf-parallel mode)
+    long long nodes;       // tree nodes allocated, including the root
+    long long exactLeaves; // leaves solved by minimax instead of rolled out
+    int       maxDepth;    // deepest node created (root = 0)
+    long long treeBytes;   // arena bytes held by the tree just before it is freed
+    int       bestVisits;  // visits of the chosen root child
+    int       rootVisits;  // visits of the root
+};
+
+/**
+ * Root statistics of a running search, published by the search thread and
+ * readable from any thread without blocking it (a seqlock: the writer bumps
+ * `sequence` to odd, writes, bumps to even; readers retry if it moved).
+ */
+class MctsProgress {
+public:
+    MctsProgress() : sequence(0), iterations(0), rootVisits(0), rootWins(0) {
+        for (int c = 0; c < BOARD_SIZE * BOARD_SIZE; ++c) {
+            visits[c] = 0;
+            wins[c] = 0;
+        }
+    }
+
+    /**
+     * Copy the root children's N/W into the shared slots. Search thread only.
+     */
+    void publish(const MctsTree& tree, long long iterationsDone) {
+        unsigned seq = sequence.load(memory_order_relaxed);
+        sequence.store(seq + 1, memory_order_relaxed);
+        atomic_thread_fence(memory_order_release);
+
+        for (int c = 0; c < BOARD_SIZE * BOARD_SIZE; ++c) {
+            visits[c].store(0, memory_order_relaxed);
+            wins[c].store(0, memory_order_relaxed);
+        }
+        const MCTSNode& root = tree.node(0);
+        for (uint32_t child = root.firstChild; child != NO_NODE; child = tree.node(child).nextSibling) {
+            visits[tree.node(child).move].store(tree.node(child).N, memory_order_relaxed);
+            wins[tree.node(child).move].store(tree.node(child).W, memory_order_relaxed);
+        }
+        iterations.store(iterationsDone, memory_order_relaxed);
+        rootVisits.store(root.N, memory_order_relaxed);
+        rootWins.store(root.W, memory_order_relaxed);
+
+        sequence.store(seq + 2, memory_order_release);
+    }
+
+    /**
+     * Consistent copy of the latest published statistics. Returns false if
+     * nothing has been published yet.
+     */
+    bool read(int outVisits[BOARD_SIZE * BOARD_SIZE], int outWins[BOARD_SIZE * BOARD_SIZE],
+              long long& outIterations, int& outRootVisits, int& outRootWins) const {
+        while (true) {
+            unsigned before = sequence.load(memory_order_acquire);
+            if (before == 0) {
+                return false;
+            }
+            if (before & 1) {
+                this_thread::yield(); // writer mid-update
+                continue;
+            }
+            for (int c = 0; c < BOARD_SIZE * BOARD_SIZE; ++c) {
+                outVisits[c] = visits[c].load(memory_order_relaxed);
+                outWins[c] = wins[c].load(memory_order_relaxed);
+            }
+            outIterations = iterations.load(memory_order_relaxed);
+            outRootVisits = rootVisits.load(memory_order_relaxed);
+            outRootWins = rootWins.load(memory_order_relaxed);
+
+            atomic_thread_fence(memory_order_acquire);
+            if (sequence.load(memory_order_relaxed) == before) {
+                return true;
+            }
+        }
+    }
+
+private:
+    atomic<unsigned> sequence;
+    atomic<int> visits[BOARD_SIZE * BOARD_SIZE];
+    atomic<int> wins[BOARD_SIZE * BOARD_SIZE];
+    atomic<long long> iterations;
+    atomic<int> rootVisits;
+    atomic<int> rootWins;
+};
+
+// How often (in iterations) runMCTS publishes progress.
+const int MCTS_PROGRESS_INTERVAL = 64;
+
+/**
+ * Run the full MCTS algorithm for a chosen number of iterations,
+ * and return the move the computer will play.
+ *
+ * If mctsOptions.timeBudgetMs is set, the search runs for that long
+ * instead and `iterations` is ignored. If mctsOptions.leafParallelRollouts
+ * is K > 1, every expanded leaf is evaluated with K rollouts spread over
+ * the task pool and backed up in one go. With mctsOptions.expandAll, a
+ * node's children are created together as one block (expandAllChildren).
+ * Leaves with at most mctsOptions.exactLeafEmpty empty cells are solved
+ * with minimax rather than rolled out, and mctsOptions.rolloutPlies turns
+ * the remaining rollouts into MCTS-MR rollouts (simulateMinimaxRollout).
+ *
+ * Setting `cancel` stops the search at the next iteration; the move
+ * returned is then the best found so far. If `progress` is given, root
+ * statistics are published to it every MCTS_PROGRESS_INTERVAL iterations
+ * and once more at the end.
+ */
+Move runMCTS(const char currentBoard[BOARD_SIZE][BOARD_SIZE], int iterations,
+             MctsStats* stats = NULL, const atomic<bool>* cancel = NULL,
+             MctsProgress* progress = NULL) {
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    const int rolloutsPerLeaf = max(1, mctsOptions.leafParallelRollouts);
+    const bool timed = mctsOptions.timeBudgetMs > 0;
+    const chrono::steady_clock::time_point deadline =
+        chrono::steady_clock::now() + chrono::milliseconds(mctsOptions.timeBudgetMs);
+
+    // Root node (index 0): it’s COMPUTER’s turn to move. Every iteration
+    // adds at most one node (unless expanding whole blocks), so a
+    // fixed-count search normally never grows the arena.
+    MctsTree tree(currentBoard, timed ? 4096 : static_cast<size_t>(iterations) + 1);
+
+    long long iterationsDone = 0;
+    long long rolloutsDone = 0;
+    long long nodesAllocated = 1;
+    long long exactLeaves = 0;
+    int maxDepth = 0;
+
+    for (int i = 0; timed || i < iterations; ++i) {
+        if (timed && chrono::steady_clock::now() >= deadline) {
+            break;
+        }
+        if (cancel != NULL && cancel->load(memory_order_relaxed)) {
+            break;
+        }
+        uint32_t path[BOARD_SIZE * BOARD_SIZE + 1];
+        int depth = 0;
+        path[0] = 0;
+        char b[BOARD_SIZE][BOARD_SIZE];
+        memcpy(b, tree.rootBoard, sizeof(b));
+
+        // ==== 1) SELECTION ====
+        // Go down the tree while the node is fully expanded (no untried
+        // moves) and has children (the game is not over), replaying each
+        // move onto the board. A block child reached for the first time is
+        // resolved and rolled out from, just like a node expandNode had
+        // just added; its own block is only created on a later visit.
+        bool reachedNewNode = false;
+        while (tree.node(path[depth]).untried == 0 &&
+               tree.node(path[depth]).firstChild != NO_NODE) {
+            uint32_t next = selectBestChild(tree, path[depth]);
+            int cell = tree.node(next).move;
+            b[cell / BOARD_SIZE][cell % BOARD_SIZE] = MctsTree::playerAt(depth);
+            path[++depth] = next;
+            if (tree.node(next).flags & NODE_PENDING) {
+                resolvePendingNode(tree, next, b);
+                reachedNewNode = true;
+                break;
+            }
+        }
+
+        // ==== 2) EXPANSION ====
+        if (!reachedNewNode && tree.node(path[depth]).untried != 0) {
+            uint32_t before = tree.size();
+            uint32_t child = mctsOptions.expandAll
+                ? expandAllChildren(tree, path[depth], b, MctsTree::playerAt(depth))
+                : expandNode(tree, path[depth], b, MctsTree::playerAt(depth));
+            path[++depth] = child;
+            nodesAllocated += tree.size() - before;
+            maxDepth = max(maxDepth, depth);
+        }
+
+        // ==== 3) SIMULATION (ROLLOUT) ====
+        const MCTSNode& leaf = tree.node(path[depth]);
+        int wins = 0;
+
+        if (!(leaf.flags & NODE_TERMINAL) &&
+            countFreeSpaces(b) <= mctsOptions.exactLeafEmpty) {
+            // Close enough to the end to solve: back up the exact result
+            // as if every rollout had reached it.
+            int score = minimax(b, 0, MctsTree::playerAt(depth) == COMPUTER, INT_MIN, INT_MAX);
+            wins = (score > 0) ? rolloutsPerLeaf : 0;
+            exactLeaves++;
+        } else if (!(leaf.flags & NODE_TERMINAL)) {
+            // Game not finished, simulate to the end.
+            if (rolloutsPerLeaf > 1) {
+                wins = runParallelRollouts(b, MctsTree::playerAt(depth), rolloutsPerLeaf);
+            } else {
+                wins = (simulateRollout(b, MctsTree::playerAt(depth)) == 10) ? 1 : 0;
+            }
+        } else {
+            // Terminal state at this node.
+            wins = (leaf.flags & NODE_COMPUTER_WIN) ? rolloutsPerLeaf : 0;
+        }
+
+        // ==== 4) BACKPROPAGATION ====
+        backpropagateBatch(tree, path, depth + 1, wins, rolloutsPerLeaf);
+
+        iterationsDone++;
+        rolloutsDone += rolloutsPerLeaf;
+
+        if (progress != NULL && iterationsDone % MCTS_PROGRESS_INTERVAL == 0) {
+            progress->publish(tree, iterationsDone);
+        }
+    }
+
+    if (progress != NULL) {
+        progress->publish(tree, iterationsDone);
+    }
+
+    // After all simulations, pick the child with the most visits.
+    uint32_t bestChild = NO_NODE;
+    int maxVisits = -1;
+
+    for (uint32_t child = tree.node(0).firstChild; child != NO_NODE;
+         child = tree.node(child).nextSibling) {
+        if (tree.node(child).N > maxVisits) {
+            maxVisits = tree.node(child).N;
+            bestChild = child;
+        }
+    }
+
+    Move bestMove = make_pair(-1, -1);
+    if (bestChild != NO_NODE) {
+        bestMove = make_pair(tree.node(bestChild).move / BOARD_SIZE,
+                             tree.node(bestChild).move % BOARD_SIZE);
+    }
+
+    if (stats != NULL || telemetrySink != NULL) {
+        MctsStats local;
+        MctsStats& out = (stats != NULL) ? *stats : local;
+        out.iterations = iterationsDone;
+        out.rollouts = rolloutsDone;
+        out.nodes = nodesAllocated;
+        out.exactLeaves = exactLeaves;
+        out.maxDepth = maxDepth;
+        out.treeBytes = static_cast<long long>(tree.bytes());
+        out.bestVisits = (bestChild != NO_NODE) ? tree.node(bestChild).N : 0;
+        out.rootVisits = tree.node(0).N;
+
+        SearchTelemetry t;
+        t.engine = "mcts";
+        t.iterations = out.iterations;
+        t.simulations = out.rollouts;
+        t.nodes = out.nodes;
+        t.maxDepth = out.maxDepth;
+        t.treeBytes = out.treeBytes;
+        t.elapsedUs = elapsedMicros(start);
+        t.move = bestMove;
+        t.visitShare = (out.rootVisits > 0)
+                     ? static_cast<double>(out.bestVisits) / out.rootVisits : 0.0;
+        t.position = PositionKey::fromBoard(currentBoard);
+        emitTelemetry(t);
+    }
+
+    if (mctsOptions.dumpTreePath != NULL &&
+        !writeTreeSnapshot(tree, mctsOptions.dumpTreePath, mctsOptions.dumpTreeDepth)) {
+        cout << "Warning: could not write tree snapshot to "
+             << mctsOptions.dumpTreePath << "\n";
+    }
+
+    return bestMove; // the tree's arena goes to the reaper with it
+}
+
+// ===============================
+// TRANSPOSITION TABLE
+// ===============================
+
+/**
+ * Fixed-size hash table of search results shared by every search thread
+ * without locks. Each entry is two 64-bit words, `check = hash ^ data`
+ * and `data`, written and read independently; a reader whose words come
+ * from two different writes sees `check ^ data != hash` and treats it as
+ * a miss, so torn entries are harmless. Four entries share one 64-byte
+ * bucket, so a probe touches a single cache line. Within a bucket a new
+ * position replaces the entry with the least remaining depth, counting
+ * entries from older searches (see newSearch) as shallower.
+ */
+class TranspositionTable {
+public:
+    enum Bound { BOUND_NONE = 0, BOUND_UPPER = 1, BOUND_LOWER = 2, BOUND_EXACT = 3 };
+
+    struct Entry {
+        int score;
+        int bound;
+        int depth;  // plies searched below the position
+        int move;   // cell of the best move, -1 if none
+    };
+
+    static const int BUCKET_ENTRIES = 4;
+
+    explicit TranspositionTable(size_t bytes, bool hugePages = hugePagesEnabled) : generation(0) {
+        size_t count = 1;
+        while (count * 2 * sizeof(Bucket) <= bytes) count *= 2;
+        memory = allocateLarge(count * sizeof(Bucket), hugePages);
+        buckets = static_cast<Bucket*>(memory.memory);
+        for (size_t b = 0; b < count; ++b) {
+            new (&buckets[b]) Bucket();
+        }
+        mask = count - 1;
+    }
+
+    ~TranspositionTable() {
+        releaseLarge(memory);
+    }
+
+    bool probe(uint64_t hash, Entry& out) const {
+        const Bucket& bucket = buckets[hash & mask];
+        for (int i = 0; i < BUCKET_ENTRIES; ++i) {
+            uint64_t data = bucket.slots[i].data.load(memory_order_relaxed);
+            uint64_t check = bucket.slots[i].check.load(memory_order_relaxed);
+            if (data != 0 && (check ^ data) == hash) {
+                out = unpack(data);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void store(uint64_t hash, int score, int bound, int depth, int move) {
+        Bucket& bucket = buckets[hash & mask];
+        uint64_t data = pack(score, bound, depth, move);
+        unsigned currentGeneration = generation.load(memory_order_relaxed);
+
+        Slot* victim = &bucket.slots[0];
+        int victimWorth = INT_MAX;
+        for (int i = 0; i < BUCKET_ENTRIES; ++i) {
+            Slot& slot = bucket.slots[i];
+            uint64_t old = slot.data.load(memory_order_relaxed);
+            if (old == 0 || (slot.check.load(memory_order_relaxed) ^ old) == hash) {
+                victim = &slot;
+                break;
+            }
+            // Depth decides, but every search of age counts as 8 plies less.
+            unsigned age = (currentGeneration - ((old >> 26) & 0xff)) & 0xff;
+            int worth = static_cast<int>((old >> 18) & 0xff) - 8 * static_cast<int>(age);
+            if (worth < victimWorth) {
+                victim = &slot;
+                victimWorth = worth;
+            }
+        }
+        victim->check.store(hash ^ data, memory_order_relaxed);
+        victim->data.store(data, memory_order_relaxed);
+    }
+
+    /** Age every existing entry by one search. */
+    void newSearch() {
+        generation.fetch_add(1, memory_order_relaxed);
+    }
+
+    void clear() {
+        for (size_t b = 0; b <= mask; ++b) {
+            for (int i = 0; i < BUCKET_ENTRIES; ++i) {
+                buckets[b].slots[i].check.store(0, memory_order_relaxed);
+                buckets[b].slots[i].data.store(0, memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t bytes() const { return (mask + 1) * sizeof(Bucket); }
+
+    PageKind pageKind() const { return memory.kind; }
+
+private:
+    struct Slot {
+        atomic<uint64_t> check;
+        atomic<uint64_t> data;
+    };
+
+    struct alignas(64) Bucket {
+        Slot slots[BUCKET_ENTRIES];
+    };
+
+    // data: score + 32768 (16 bits) | bound (2) | depth (8) | generation (8) | move + 1 (4).
+    // A stored entry always has a bound, so data == 0 marks an empty slot.
+    uint64_t pack(int score, int bound, int depth, int move) const {
+        return static_cast<uint64_t>(score + 32768)
+             | static_cast<uint64_t>(bound) << 16
+             | static_cast<uint64_t>(depth & 0xff) << 18
+             | static_cast<uint64_t>(generation.load(memory_order_relaxed) & 0xff) << 26
+             | static_cast<uint64_t>(move + 1) << 34;
+    }
+
+    static Entry unpack(uint64_t data) {
+        Entry e;
+        e.score = static_cast<int>(data & 0xffff) - 32768;
+        e.bound = static_cast<int>((data >> 16) & 3);
+        e.depth = static_cast<int>((data >> 18) & 0xff);
+        e.move = static_cast<int>((data >> 34) & 0xf) - 1;
+        return e;
+    }
+
+    LargeAllocation memory;
+    Bucket* buckets;
+    size_t mask;
+    atomic<unsigned> generation;
+};
+
+// Size of the shared table; 0 disables it (--tt-mb).
+size_t transpositionTableBytes = 1 << 20;
+
+/**
+ * The process-wide table used by minimax, or NULL if disabled.
+ */
+TranspositionTable* getTranspositionTable() {
+    static TranspositionTable* table =
+        (transpositionTableBytes > 0) ? new TranspositionTable(transpositionTableBytes) : NULL;
+    return table;
+}
+
+// ===============================
+// MINIMAX IMPLEMENTATION (HARD)
+// ===============================
+
+// Per-thread search counters, read by findBestMinimaxMove for telemetry.
+thread_local long long minimaxPositions = 0;
+thread_local int minimaxMaxDepth = 0;
+
+// Lets a caller (the benchmarks) search without the shared table.
+thread_local bool minimaxUsesTable = true;
+
+/**
+ * Minimax with alpha-beta pruning.
+ * Returns:
+ *   +10 if COMPUTER is winning
+ *   -10 if PLAYER is winning
+ *    0  for draw or equal outcome
+ * Scores don't depend on the path, so results are shared between
+ * transpositions (and between threads) through the transposition table.
+ * If `cancel` is set while searching, the search unwinds immediately and
+ * the score is meaningless.
+ */
+int minimax(char currentBoard[BOARD_SIZE][BOARD_SIZE],
+            int depth,
+            bool isMaximizing,
+            int alpha,
+            int beta,
+            const atomic<bool>* cancel)
+{
+    if (cancel != NULL && cancel->load(memory_order_relaxed)) {
+        return 0;
+    }
+
+    minimaxPositions++;
+    if (depth > minimaxMaxDepth) {
+        minimaxMaxDepth = depth;
+    }
+
+    char winner = checkWinner(currentBoard);
+
+    if (winner == COMPUTER) return 10;
+    if (winner == PLAYER)   return -10;
+    if (winner == 'D')      return 0;
+
+    TranspositionTable* table = minimaxUsesTable ? getTranspositionTable() : NULL;
+    PositionKey key = PositionKey::fromBoard(currentBoard);
+    // The caller chooses who moves, so it is part of the key.
+    uint64_t hash = key.hash() ^ (isMaximizing ? 0x5bd1e9955bd1e995ULL : 0);
+    if (table != NULL) {
+        TranspositionTable::Entry entry;
+        if (table->probe(hash, entry)) {
+            if (entry.bound == TranspositionTable::BOUND_EXACT) return entry.score;
+            if (entry.bound == TranspositionTable::BOUND_LOWER) alpha = max(alpha, entry.score);
+            if (entry.bound == TranspositionTable::BOUND_UPPER) beta = min(beta, entry.score);
+            if (alpha >= beta) return entry.score;
+        }
+    }
+    const int alphaIn = alpha;
+    const int betaIn = beta;
+
+    int bestScore = isMaximizing ? INT_MIN : INT_MAX;
+    int bestCell = -1;
+    // COMPUTER maximises, PLAYER minimises: try all moves.
+    for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE && alpha < beta; ++cell) {
+        char& c = currentBoard[cell / BOARD_SIZE][cell % BOARD_SIZE];
+        if (c != ' ') {
+            continue;
+        }
+        c = isMaximizing ? COMPUTER : PLAYER;
+        int score = minimax(currentBoard, depth + 1, !isMaximizing, alpha, beta, cancel);
+        c = ' ';
+
+        if (isMaximizing ? score > bestScore : score < bestScore) {
+            bestScore = score;
+            bestCell = cell;
+        }
+        // Cut off the rest of the branch once the window closes.
+        if (isMaximizing) alpha = max(alpha, score);
+        else              beta = min(beta, score);
+    }
+
+    if (table != NULL && !(cancel != NULL && cancel->load(memory_order_relaxed))) {
+        int bound = (bestScore <= alphaIn) ? TranspositionTable::BOUND_UPPER
+                  : (bestScore >= betaIn)  ? TranspositionTable::BOUND_LOWER
+                                           : TranspositionTable::BOUND_EXACT;
+        table->store(hash, bestScore, bound, BOARD_SIZE * BOARD_SIZE - key.marks(), bestCell);
+    }
+    return bestScore;
+}
+
+/**
+ * Find the computer's best move with minimax. Each root move is searched
+ * as its own task on the shared pool, on a private copy of the board.
+ * Returns (-1,-1) if `cancel` was set before the search finished.
+ */
+Move findBestMinimaxMove(const char currentBoard[BOARD_SIZE][BOARD_SIZE],
+                         const atomic<bool>* cancel = NULL) {
+    const chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    int scores[BOARD_SIZE * BOARD_SIZE];
+    atomic<long long> positions(0);
+    atomic<int> maxDepth(0);
+    if (getTranspositionTable() != NULL) {
+        getTranspositionTable()->newSearch();
+    }
+
+    TaskGroup group(getTaskPool());
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        for (int j = 0; j < BOARD_SIZE; ++j) {
+            if (currentBoard[i][j] != ' ') {
+                continue;
+            }
+            group.run([&, i, j]() {
+                char childBoard[BOARD_SIZE][BOARD_SIZE];
+                for (int r = 0; r < BOARD_SIZE; ++r) {
+                    for (int c = 0; c < BOARD_SIZE; ++c) {
+                        childBoard[r][c] = currentBoard[r][c];
+                    }
+                }
+                childBoard[i][j] = COMPUTER;
+
+                long long positionsBefore = minimaxPositions;
+                minimaxMaxDepth = 0;
+                scores[i * BOARD_SIZE + j] = minimax(childBoard, 0, false, INT_MIN, INT_MAX, cancel);
+                positions += minimaxPositions - positionsBefore;
+
+                int depthSeen = minimaxMaxDepth + 1; // +1 for the root move itself
+                int previous = maxDepth.load();
+                while (depthSeen > previous &&
+                       !maxDepth.compare_exchange_weak(previous, depthSeen)) {
+                }
+            });
+        }
+    }
+    group.wait();
+
+    if (cancel != NULL && cancel->load()) {
+        return make_pair(-1, -1);
+    }
+
+    // Pick in board order so ties resolve the same way as a serial search.
+    int bestScore = INT_MIN;
+    Move bestMove = make_pair(-1, -1);
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        for (int j = 0; j < BOARD_SIZE; ++j) {
+            if (currentBoard[i][j] == ' ' && scores[i * BOARD_SIZE + j] > bestScore) {
+                bestScore = scores[i * BOARD_SIZE + j];
+                bestMove = make_pair(i, j);
+            }
+        }
+    }
+
+    if (telemetrySink != NULL) {
+        SearchTelemetry t;
+        t.engine = "minimax";
+        t.iterations = positions.load();
+        t.simulations = positions.load();
+        t.nodes = positions.load();
+        t.maxDepth = maxDepth.load();
+        t.treeBytes = 0;
+        t.elapsedUs = elapsedMicros(start);
+        t.move = bestMove;
+        t.visitShare = -1.0;
+        t.position = PositionKey::fromBoard(currentBoard);
+        emitTelemetry(t);
+    }
+    return bestMove;
+}
+
+/**
+ * Use minimax to choose and play the best possible move for the computer.
+ */
+void minimaxMove() {
+    cout << "Computer thinking...\n";
+
+    Move bestMove = findBestMinimaxMove(board);
+
+    if (bestMove.first != -1) {
+        board[bestMove.first][bestMove.second] = COMPUTER;
+        computerMoves.push_back(bestMove);
+    } else {
+        cout << "Error: could not find a valid move.\n";
+    }
+}
+
+// ===============================
+// ASYNCHRONOUS SEARCH
+// ===============================
+
+/**
+ * State shared between a search running on the task pool and its handle.
+ */
+struct SearchState {
+    atomic<bool> cancelled;
+    mutex lock;
+    condition_variable finishedSignal;
+    bool finished;
+    Move result;
+    function<void(Move)> continuation; // run once when the search finishes
+    MctsProgress progress;              // live root statistics (MCTS only)
+    bool publishesProgress;
+
+    SearchState()
+        : cancelled(false), finished(false), result(make_pair(-1, -1)),
+          publishesProgress(false) {}
+};
+
+/**
+ * Snapshot of a running search, answered without stopping it.
+ */
+struct SearchInfo {
+    Move bestMove;                            // most visited root move so far
+    int visits[BOARD_SIZE * BOARD_SIZE];      // root visit count per cell (row * 3 + column)
+    double visitShare[BOARD_SIZE * BOARD_SIZE];
+    double value;                             // estimated COMPUTER win rate at the root
+    long long iterations;
+    bool finished;
+};
+
+/**
+ * Handle to a search started with startMinimaxSearch / startMctsSearch.
+ * Copies share the same search. Dropping every handle does not stop the
+ * search; call cancel() for that.
+ */
+class SearchHandle {
+public:
+    explicit SearchHandle(const shared_ptr<SearchState>& s) : state(s) {}
+
+    /**
+     * Ask the search to stop. Minimax checks at every node and MCTS at
+     * every iteration, so the worker is freed almost immediately.
+     */
+    void cancel() {
+        state->cancelled = true;
+    }
+
+    bool cancelled() const {
+        return state->cancelled.load();
+    }
+
+    bool ready() const {
+        lock_guard<mutex> lock(state->lock);
+        return state->finished;
+    }
+
+    /**
+     * Wait up to `ms` milliseconds; returns true if the search finished.
+     */
+    bool waitFor(int ms) const {
+        unique_lock<mutex> lock(state->lock);
+        return state->finishedSignal.wait_for(lock, chrono::milliseconds(ms),
+                                              [this]() { return state->finished; });
+    }
+
+    /**
+     * Block until the search finishes and return its move, or (-1,-1) if
+     * it was cancelled before producing one.
+     */
+    Move get() const {
+        unique_lock<mutex> lock(state->lock);
+        while (!state->finished) {
+            state->finishedSignal.wait(lock);
+        }
+        return state->result;
+    }
+
+    /**
+     * Current best move, visit distribution and value of a running MCTS
+     * search. Never blocks the search thread. Returns false for minimax
+     * searches and before the first statistics are published.
+     */
+    bool peek(SearchInfo& info) const {
+        if (!state->publishesProgress) {
+            return false;
+        }
+        int wins[BOARD_SIZE * BOARD_SIZE];
+        int rootVisits = 0;
+        int rootWins = 0;
+        info.finished = ready();
+        if (!state->progress.read(info.visits, wins, info.iterations, rootVisits, rootWins)) {
+            return false;
+        }
+
+        int bestVisits = 0;
+        info.bestMove = make_pair(-1, -1);
+        for (int c = 0; c < BOARD_SIZE * BOARD_SIZE; ++c) {
+            info.visitShare[c] = rootVisits > 0 ? static_cast<double>(info.visits[c]) / rootVisits : 0.0;
+            if (info.visits[c] > bestVisits) {
+                bestVisits = info.visits[c];
+                info.bestMove = make_pair(c / BOARD_SIZE, c % BOARD_SIZE);
+            }
+        }
+        info.value = rootVisits > 0 ? static_cast<double>(rootWins) / rootVisits : 0.0;
+        return true;
+    }
+
+    /**
+     * Run `callback` with the result when the search finishes (right away,
+     * on this thread, if it already has). Replaces any earlier callback.
+     */
+    void then(const function<void(Move)>& callback) {
+        unique_lock<mutex> lock(state->lock);
+        if (!state->finished) {
+            state->continuation = callback;
+            return;
+        }
+        Move result = state->result;
+        lock.unlock();
+        callback(result);
+    }
+
+private:
+    shared_ptr<SearchState> state;
+};
+
+/**
+ * Publish a search result and run the continuation, if any.
+ */
+void finishSearch(const shared_ptr<SearchState>& state, Move result) {
+    function<void(Move)> continuation;
+    {
+        lock_guard<mutex> lock(state->lock);
+        state->result = result;
+        state->finished = true;
+        continuation.swap(state->continuation);
+    }
+    state->finishedSignal.notify_all();
+    if (continuation) {
+        continuation(result);
+    }
+}
+
+/**
+ * Board copy that can be captured by value in a task.
+ */
+struct BoardCopy {
+    char cells[BOARD_SIZE][BOARD_SIZE];
+
+    explicit BoardCopy(const char b[BOARD_SIZE][BOARD_SIZE]) {
+        memcpy(cells, b, sizeof(cells));
+    }
+};
+
+/**
+ * Start a minimax search for the computer's move on the task pool.
+ */
+SearchHandle startMinimaxSearch(const char currentBoard[BOARD_SIZE][BOARD_SIZE]) {
+    shared_ptr<SearchState> state = make_shared<SearchState>();
+    BoardCopy position(currentBoard);
+
+    getTaskPool().submit([state, position]() {
+        Move move = make_pair(-1, -1);
+        if (!state->cancelled.load()) {
+            move = findBestMinimaxMove(position.cells, &state->cancelled);
+        }
+        finishSearch(state, move);
+    });
+    return SearchHandle(state);
+}
+
+/**
+ * Start an MCTS search for the computer's move on the task pool.
+ * A cancelled search reports (-1,-1) rather than its partial best move.
+ */
+SearchHandle startMctsSearch(const char currentBoard[BOARD_SIZE][BOARD_SIZE], int iterations) {
+    shared_ptr<SearchState> state = make_shared<SearchState>();
+    state->publishesProgress = true;
+    BoardCopy position(currentBoard);
+
+    getTaskPool().submit([state, position, iterations]() {
+        Move move = make_pair(-1, -1);
+        if (!state->cancelled.load()) {
+            move = runMCTS(position.cells, iterations, NULL, &state->cancelled, &state->progress);
+        }
+        finishSearch(state, state->cancelled.load() ? make_pair(-1, -1) : move);
+    });
+    return SearchHandle(state);
+}
+
+/**
+ * Wrapper for computer’s MCTS move. Long searches (time budgets) print an
+ * info line every half second with the search's current opinion.
+ */
+void mctsMove(int iterations) {
+    if (mctsOptions.timeBudgetMs > 0) {
+        cout << "Computer is thinking (MCTS for " << mctsOptions.timeBudgetMs
+             << " ms)...\n";
+    } else {
+        cout << "Computer is thinking (MCTS with " << iterations
+             << " simulations)...\n";
+    }
+
+    SearchHandle search = startMctsSearch(board, iterations);
+    while (!search.waitFor(500)) {
+        SearchInfo info;
+        if (search.peek(info) && info.bestMove.first != -1) {
+            int cell = info.bestMove.first * BOARD_SIZE + info.bestMove.second;
+            ostringstream line;
+            line << "  info: " << info.iterations << " iterations, best ("
+                 << info.bestMove.first + 1 << "," << info.bestMove.second + 1 << ") "
+                 << fixed << setprecision(0) << info.visitShare[cell] * 100 << "% of visits, "
+                 << "win estimate " << setprecision(2) << info.value << "\n";
+            cout << line.str() << flush;
+        }
+    }
+    Move bestMove = search.get();
+
+    if (bestMove.first != -1) {
+        board[bestMove.first][bestMove.second] = COMPUTER;
+        computerMoves.push_back(bestMove);
+    } else {
+        cout << "Error: MCTS could not find a valid move.\n";
+    }
+}
+
+// ===============================
+// BASIC BOARD / GAME FUNCTIONS
+// ===============================
+
+void resetBoard() {
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        for (int j = 0; j < BOARD_SIZE; ++j) {
+            board[i][j] = ' ';
+        }
+    }
+}
+
+// Redraw each frame in place with ANSI escapes instead of scrolling.
+bool ansiRedraw = false;
+
+/**
+ * Write a finished frame to stdout with a single write() call. Anything
+ * still buffered in cout goes out first so output stays in order.
+ */
+void writeFrame(const string& frame) {
+    cout.flush();
+#ifdef __unix__
+    const char* data = frame.data();
+    size_t left = frame.size();
+    while (left > 0) {
+        ssize_t written = write(STDOUT_FILENO, data, left);
+        if (written <= 0) {
+            break; // nothing sensible to do if stdout is gone
+        }
+        data += written;
+        left -= static_cast<size_t>(written);
+    }
+#else
+    cout << frame << flush;
+#endif
+}
+
+/**
+ * Append the board grid to a frame.
+ */
+void appendBoard(string& frame) {
+    frame += "\n    1   2   3\n";
+    frame += "  +---+---+---+\n";
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        frame += static_cast<char>('1' + i);
+        frame += " | ";
+        for (int j = 0; j < BOARD_SIZE; ++j) {
+            frame += board[i][j];
+            frame += " | ";
+        }
+        frame += "\n";
+        frame += "  +---+---+---+\n";
+    }
+}
+
+/**
+ * Append one side's moves as "(r,c) " pairs.
+ */
+void appendMoveList(string& frame, const vector<Move>& moves) {
+    for (size_t i = 0; i < moves.size(); ++i) {
+        frame += '(';
+        frame += static_cast<char>('1' + moves[i].first);
+        frame += ',';
+        frame += static_cast<char>('1' + moves[i].second);
+        frame += ") ";
+    }
+}
+
+/**
+ * Append the move history for both sides.
+ */
+void appendPastMoves(string& frame, char mode) {
+    frame += "\nPast Moves:\n";
+    if (mode == '1') {
+        // Player vs Player
+        frame += "Player 1 (X): ";
+        appendMoveList(frame, playerMoves);
+        frame += "\nPlayer 2 (O): ";
+        appendMoveList(frame, computerMoves);
+    } else {
+        // Player vs Computer
+        frame += "Player (X): ";
+        appendMoveList(frame, playerMoves);
+        frame += "\nComputer (O): ";
+        appendMoveList(frame, computerMoves);
+    }
+    frame += "\n";
+}
+
+/**
+ * Build a whole frame (board, move history, status text) and write it
+ * at once. With --ansi the screen is cleared first so the board is
+ * redrawn in place.
+ */
+void renderFrame(char mode, const string& status) {
+    string frame;
+    frame.reserve(512);
+    frame += ansiRedraw ? "\x1b[H\x1b[2J" : "\n";
+    appendBoard(frame);
+    appendPastMoves(frame, mode);
+    frame += status;
+    writeFrame(frame);
+}
+
+/**
+ * Count empty spaces on a board.
+ */
+int countFreeSpaces(const char b[BOARD_SIZE][BOARD_SIZE]) {
+    int freeSpaces = 0;
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        for (int j = 0; j < BOARD_SIZE; ++j) {
+            if (b[i][j] == ' ') {
+                freeSpaces++;
+            }
+        }
+    }
+    return freeSpaces;
+}
+
+/**
+ * Return:
+ *   'X' if player X wins
+ *   'O' if player O wins
+ *   'D' if draw
+ *   ' ' if game not finished yet
+ */
+char checkWinner(const char b[BOARD_SIZE][BOARD_SIZE]) {
+    // Check rows.
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        if (b[i][0] != ' ' &&
+            b[i][0] == b[i][1] &&
+            b[i][1] == b[i][2]) {
+            return b[i][0];
+        }
+    }
+
+    // Check columns.
+    for (int j = 0; j < BOARD_SIZE; ++j) {
+        if (b[0][j] != ' ' &&
+            b[0][j] == b[1][j] &&
+            b[1][j] == b[2][j]) {
+            return b[0][j];
+        }
+    }
+
+    // Diagonals.
+    if (b[0][0] != ' ' &&
+        b[0][0] == b[1][1] &&
+        b[1][1] == b[2][2]) {
+        return b[0][0];
+    }
+    if (b[0][2] != ' ' &&
+        b[0][2] == b[1][1] &&
+        b[1][1] == b[2][0]) {
+        return b[0][2];
+    }
+
+    // Check for draw.
+    if (countFreeSpaces(b) == 0) {
+        return 'D';
+    }
+
+    // Game is still ongoing.
+    return ' ';
+}
+
+// ===============================
+// INPUT HANDLING
+// ===============================
+
+/**
+ * Generic function to handle one player's move (human).
+ * Asks for row/column until a valid empty tile is chosen.
+ */
+void handlePlayerMove(char playerChar, vector<pair<int,int> >& moveLog) {
+    int row = 0;
+    int column = 0;
+
+    while (true) {
+        cout << "Enter Row and Column (1-3 1-3): ";
+
+        if (!(cin >> row)) {
+            cout << "Invalid input type. Please enter numbers only.\n";
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            continue;
+        }
+
+        if (!(cin >> column)) {
+            cout << "Invalid input type. Please enter numbers only.\n";
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            continue;
+        }
+
+        if (row < 1 || row > BOARD_SIZE ||
+            column < 1 || column > BOARD_SIZE) {
+            cout << "Invalid range. Please enter numbers between 1 and "
+                 << BOARD_SIZE << ".\n";
+            continue;
+        }
+
+        int r = row - 1;
+        int c = column - 1;
+
+        if (board[r][c] != ' ') {
+            cout << "Tile (" << row << "," << column
+                 << ") is already taken. Try again.\n";
+        } else {
+            board[r][c] = playerChar;
+            moveLog.push_back(make_pair(r, c));
+            break;
+        }
+    }
+}
+
+void playerMove() {
+    handlePlayerMove(PLAYER, playerMoves);
+}
+
+void player2Move() {
+    handlePlayerMove(COMPUTER, computerMoves);
+}
+
+// ===============================
+// DIFFICULTY & RANDOM MOVE
+// ===============================
+
+/**
+ * Ask player which difficulty to use for the computer.
+ * E = random, M = MCTS, H = Minimax
+ */
+char selectComputerDifficulty() {
+    char aiChoice;
+
+    while (true) {
+        cout << "\nSelect Computer Difficulty:\n";
+        cout << "R. Regular  (Random moves)\n";
+        cout << "H. Hard (MCTS simulations)\n";
+        cout << "I. Impossible   (Minimax algorithm)\n";
+        cout << "Enter your choice (R/H/I): ";
+
+        cin >> aiChoice;
+
+        if (cin.fail()) {
+            cout << "Invalid input. Please enter R, H, or I.\n";
+            cin.clear();
+            cin.ignore(numeric_limits<streamsize>::max(), '\n');
+            continue;
+        }
+
+        aiChoice = toupper(aiChoice);
+        if (aiChoice == 'R' || aiChoice == 'H' || aiChoice == 'I') {
+            break;
+        }
+
+        cout << "Invalid choice. Please enter R, H, or I.\n";
+    }
+    return aiChoice;
+}
+
+/**
+ * For Easy mode: pick a random empty cell.
+ */
+Move getRandomComputerMove(const char currentBoard[BOARD_SIZE][BOARD_SIZE]) {
+    vector<Move> freeSpaces;
+
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        for (int j = 0; j < BOARD_SIZE; ++j) {
+            if (currentBoard[i][j] == ' ') {
+                freeSpaces.push_back(make_pair(i, j));
+            }
+        }
+    }
+
+    if (freeSpaces.empty()) {
+        return make_pair(-1, -1);
+    }
+
+    int randomIndex = rand() % freeSpaces.size();
+    return freeSpaces[randomIndex];
+}
+
+/**
+ * Change these numbers to adjust how "smart" Medium (MCTS) feels.
+ * More simulations = stronger but slower. Run with --calibrate to see
+ * how much strength each setting actually buys per CPU millisecond.
+ */
+int getMctsIterationsForDifficulty(char aiChoice) {
+    if (aiChoice == 'H') {
+        // Medium: reasonable default. 
+        return 10000; // Can change number of simulatioons
+    }
+    return 0;
+}
+
+// ===============================
+// WINNER MESSAGE
+// ===============================
+
+/**
+ * Text announcing the result of a finished game.
+ */
+string winnerMessage(char winner, char chosenMode) {
+    if (winner == PLAYER) {
+        if (chosenMode == '1') {
+            return "Player 1 (X) wins!\n";
+        }
+        return "Congratulations! You win!\n";
+    } else if (winner == COMPUTER) {
+        if (chosenMode == '1') {
+            return "Player 2 (O) wins!\n";
+        }
+        return "Computer wins! Better luck next time!\n";
+    } else if (winner == 'D') {
+        return "          IT'S A TIE!\n"
+               "       |\\_,,,---,,_\n"
+               "ZZZzz /,`.-'`'    -.  ;-;;,_\n"
+               "     |,4-  ) )-,_. ,\\ (  `'-'\n"
+               "    '---''(_/--'  `-'\\_)\n";
+    }
+    return "Game ended unexpectedly.\n";
+}
+
+// ===============================
+// GAME SESSIONS (COROUTINES)
+// ===============================
+
+class SessionExecutor;
+
+/**
+ * One game, played by a coroutine. X is a human ('P', moves arrive through
+ * deliverHumanMove) or the random player ('R'); O is a human or one of the
+ * computer difficulties ('R', 'H', 'I').
+ */
+struct GameSession {
+    char cells[BOARD_SIZE][BOARD_SIZE];
+    unsigned char moves[BOARD_SIZE * BOARD_SIZE]; // cells played, as row * 3 + column
+    unsigned char moveCount;
+    char xPlayer;
+    char oPlayer;
+    char winner; // checkWinner() result once the game is over
+
+    SessionExecutor* executor;
+    atomic<void*> waitingForHuman; // coroutine address while suspended on a human move
+    Move humanMove;
+
+    GameSession(char x, char o, SessionExecutor* e)
+        : moves(), moveCount(0), xPlayer(x), oPlayer(o), winner(' '), executor(e),
+          waitingForHuman(NULL), humanMove(make_pair(-1, -1))
+    {
+        memset(cells, ' ', sizeof(cells));
+    }
+
+    // Running coroutines hold references to their session, so sessions
+    // are built in place and never copied.
+    GameSession(const GameSession&) = delete;
+    GameSession& operator=(const GameSession&) = delete;
+
+    bool awaitingHumanMove() const {
+        return waitingForHuman.load() != NULL;
+    }
+};
+
+/**
+ * Coroutine return type for a game session. The frame starts suspended
+ * (SessionExecutor::spawn schedules it) and frees itself when it ends.
+ */
+struct SessionTask {
+    struct promise_type {
+        SessionTask get_return_object() {
+            return SessionTask(coroutine_handle<promise_type>::from_promise(*this));
+        }
+        suspend_always initial_suspend() noexcept { return suspend_always(); }
+        suspend_never final_suspend() noexcept { return suspend_never(); }
+        void return_void() {}
+        void unhandled_exception() { terminate(); }
+
+        // Track frame sizes so --sessions can report the per-game cost.
+        static void* operator new(size_t size) {
+            frameBytes.store(size, memory_order_relaxed);
+            return ::operator new(size);
+        }
+        static void operator delete(void* p) {
+            ::operator delete(p);
+        }
+
+        static atomic<size_t> frameBytes;
+    };
+
+    explicit SessionTask(coroutine_handle<promise_type> h) : handle(h) {}
+
+    coroutine_handle<promise_type> handle;
+};
+
+atomic<size_t> SessionTask::promise_type::frameBytes(0);
+
+/**
+ * Runs session coroutines on the shared task pool. Resuming a session is
+ * just a pool task, so sessions and the searches they wait on share the
+ * same threads. At most `maxSearches` engine searches are in flight at
+ * once; sessions beyond that queue here for a slot, so the pool never holds
+ * more searches than it can work through.
+ */
+class SessionExecutor {
+public:
+    SessionExecutor()
+        : liveSessions(0), maxSearches(2 * getTaskPool().size()),
+          searchesInFlight(0), peakSearches(0) {}
+
+    void schedule(coroutine_handle<> h) {
+        getTaskPool().submit([h]() { h.resume(); });
+    }
+
+    void spawn(const SessionTask& task) {
+        ++liveSessions;
+        schedule(task.handle);
+    }
+
+    /**
+     * Run `start` (which launches a search) now if a search slot is free,
+     * otherwise once one is. The search must call searchFinished() when done.
+     */
+    void startSearch(const function<void()>& start) {
+        {
+            lock_guard<mutex> lock(searchMutex);
+            if (searchesInFlight >= maxSearches) {
+                waitingSearches.push_back(start);
+                return;
+            }
+            searchesInFlight++;
+            peakSearches = max(peakSearches, searchesInFlight);
+        }
+        start();
+    }
+
+    /**
+     * Release a search slot, handing it straight to the next queued search.
+     */
+    void searchFinished() {
+        function<void()> next;
+        {
+            lock_guard<mutex> lock(searchMutex);
+            if (waitingSearches.empty()) {
+                searchesInFlight--;
+                return;
+            }
+            next = waitingSearches.front();
+            waitingSearches.pop_front();
+        }
+        next();
+    }
+
+    /**
+     * Called by a session as its last action.
+     */
+    void sessionFinished() {
+        lock_guard<mutex> lock(doneMutex);
+        if (--liveSessions == 0) {
+            allDone.notify_all();
+        }
+    }
+
+    /**
+     * Block until every spawned session has finished. The pool workers run
+     * the sessions; the waiter doesn't pick up session tasks itself, so no
+     * search ever runs nested on its stack.
+     */
+    void waitAll() {
+        unique_lock<mutex> lock(doneMutex);
+        while (liveSessions.load() > 0) {
+            allDone.wait(lock);
+        }
+    }
+
+    int live() const {
+        return liveSessions.load();
+    }
+
+    /**
+     * Most engine searches that were ever in flight at once (at most
+     * `maxSearches`).
+     */
+    int peakSearchesInFlight() {
+        lock_guard<mutex> lock(searchMutex);
+        return peakSearches;
+    }
+
+private:
+    atomic<int> liveSessions;
+    mutex doneMutex;
+    condition_variable allDone;
+
+    const int maxSearches;
+    int searchesInFlight;
+    int peakSearches;
+    deque<function<void()> > waitingSearches;
+    mutex searchMutex;
+};
+
+/**
+ * Awaitable for the next human move in a session.
+ */
+struct HumanMoveAwaiter {
+    GameSession& session;
+
+    bool await_ready() const { return false; }
+    void await_suspend(coroutine_handle<> h) { session.waitingForHuman = h.address(); }
+    Move await_resume() const { return session.humanMove; }
+};
+
+/**
+ * Hand a human move to a session that is waiting for one. Returns false
+ * (and leaves the session waiting) if it isn't waiting or the move is illegal.
+ * Only one thread may deliver moves to a given session.
+ */
+bool deliverHumanMove(GameSession& session, Move move) {
+    if (!session.awaitingHumanMove() ||
+        move.first < 0 || move.first >= BOARD_SIZE ||
+        move.second < 0 || move.second >= BOARD_SIZE ||
+        session.cells[move.first][move.second] != ' ') {
+        return false;
+    }
+    session.humanMove = move;
+    void* address = session.waitingForHuman.exchange(NULL);
+    session.executor->schedule(coroutine_handle<>::from_address(address));
+    return true;
+}
+
+/**
+ * Awaitable for a computer move. Random moves are computed inline; the
+ * search engines run as asynchronous searches and resume the session
+ * through the executor when they finish.
+ */
+struct EngineMoveAwaiter {
+    GameSession& session;
+    char engine;
+    Move result;
+
+    bool await_ready() {
+        if (engine == 'R') {
+            result = getRandomComputerMove(session.cells);
+            return true;
+        }
+        return false;
+    }
+
+    void await_suspend(coroutine_handle<> h) {
+        SessionExecutor* executor = session.executor;
+        executor->startSearch([this, h, executor]() {
+            SearchHandle search = (engine == 'I')
+                ? startMinimaxSearch(session.cells)
+                : startMctsSearch(session.cells, getMctsIterationsForDifficulty(engine));
+            search.then([this, h, executor](Move move) {
+                result = move;
+                executor->searchFinished();
+                executor->schedule(h);
+            });
+        });
+    }
+
+    Move await_resume() const { return result; }
+};
+
+/**
+ * Awaitable that requeues the session so other games get a turn.
+ */
+struct YieldAwaiter {
+    SessionExecutor& executor;
+
+    bool await_ready() const { return false; }
+    void await_suspend(coroutine_handle<> h) { executor.schedule(h); }
+    void await_resume() const {}
+};
+
+/**
+ * The game loop for one session.
+ */
+SessionTask playSession(GameSession& session) {
+    char currentPlayer = PLAYER; // X always starts.
+
+    while (session.winner == ' ') {
+        char controller = (currentPlayer == PLAYER) ? session.xPlayer : session.oPlayer;
+
+        Move move;
+        if (controller == 'P') {
+            move = co_await HumanMoveAwaiter{ session };
+        } else if (currentPlayer == PLAYER) {
+            move = getRandomComputerMove(session.cells);
+        } else {
+            move = co_await EngineMoveAwaiter{ session, controller, make_pair(-1, -1) };
+        }
+
+        if (move.first == -1) {
+            break; // engine failed or search cancelled
+        }
+        session.cells[move.first][move.second] = currentPlayer;
+        session.moves[session.moveCount++] =
+            static_cast<unsigned char>(move.first * BOARD_SIZE + move.second);
+        session.winner = checkWinner(session.cells);
+        currentPlayer = (currentPlayer == PLAYER ? COMPUTER : PLAYER);
+
+        co_await YieldAwaiter{ *session.executor };
+    }
+
+    if (gameLogger != NULL) {
+        gameLogger->log(makeGameRecord(session.xPlayer, session.oPlayer, session.winner,
+                                       session.moves, session.moveCount));
+    }
+    session.executor->sessionFinished();
+}
+
+/**
+ * Play `count` concurrent headless games, random X against `engine` as O,
+ * all interleaved on the task pool, and report throughput.
+ *
+ * With `remoteX`, X is a human player ('P') whose random moves are handed
+ * in by this thread through deliverHumanMove, the way a network front end
+ * would: each session suspends until its move arrives.
+ */
+void runConcurrentSessions(int count, char engine, bool remoteX) {
+    SessionExecutor executor;
+    deque<GameSession> sessions; // never relocates, so sessions stay put
+    for (int i = 0; i < count; ++i) {
+        sessions.emplace_back(remoteX ? 'P' : 'R', engine, &executor);
+    }
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    for (int i = 0; i < count; ++i) {
+        executor.spawn(playSession(sessions[i]));
+    }
+    long long humanMoves = 0;
+    while (remoteX && executor.live() > 0) {
+        int delivered = 0;
+        for (int i = 0; i < count; ++i) {
+            if (sessions[i].awaitingHumanMove() &&
+                deliverHumanMove(sessions[i], getRandomComputerMove(sessions[i].cells))) {
+                delivered++;
+            }
+        }
+        humanMoves += delivered;
+        if (delivered == 0) {
+            this_thread::yield();
+        }
+    }
+    executor.waitAll();
+    double seconds = elapsedMicros(start) / 1e6;
+
+    int results[3] = { 0, 0, 0 }; // X wins, draws, O wins
+    for (int i = 0; i < count; ++i) {
+        if (sessions[i].winner == PLAYER)        results[0]++;
+        else if (sessions[i].winner == COMPUTER) results[2]++;
+        else                                     results[1]++;
+    }
+
+    cout << "Sessions: " << count << " games, " << (remoteX ? "remote" : "random")
+         << " X vs engine " << engine << " as O, " << getTaskPool().size() << " pool threads\n"
+         << "X wins / draws / O wins: " << results[0] << " / " << results[1]
+         << " / " << results[2] << "\n";
+    if (remoteX) {
+        cout << "Human moves delivered: " << humanMoves << "\n";
+    }
+    cout << "Peak searches in flight: " << executor.peakSearchesInFlight() << "\n"
+         << "Per game: " << sizeof(GameSession) << " bytes of session state + "
+         << SessionTask::promise_type::frameBytes.load() << " bytes of coroutine frame\n"
+         << fixed << setprecision(3) << "Elapsed: " << seconds << " s ("
+         << setprecision(0) << (seconds > 0 ? count / seconds : 0.0) << " games/s)\n";
+}
+
+// ===============================
+// LEAF-PARALLEL COMPARISON
+// ===============================
+
+/**
+ * Perfect-play move for PLAYER (X), used as a reference opponent.
+ */
+Move getMinimaxPlayerMove(char currentBoard[BOARD_SIZE][BOARD_SIZE]) {
+    int bestScore = INT_MAX;
+    Move bestMove = make_pair(-1, -1);
+
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        for (int j = 0; j < BOARD_SIZE; ++j) {
+            if (currentBoard[i][j] == ' ') {
+                currentBoard[i][j] = PLAYER;
+                int score = minimax(currentBoard, 0, true, INT_MIN, INT_MAX);
+                currentBoard[i][j] = ' ';
+
+                if (score < bestScore) {
+                    bestScore = score;
+                    bestMove = make_pair(i, j);
+                }
+            }
+        }
+    }
+    return bestMove;
+}
+
+/**
+ * Play one game with MCTS as COMPUTER (O) against a reference X player
+ * ('R' = random, 'I' = perfect play). Returns the checkWinner() result.
+ */
+char playMctsReferenceGame(char opponent, int iterations, MctsStats& totals) {
+    char b[BOARD_SIZE][BOARD_SIZE];
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        for (int j = 0; j < BOARD_SIZE; ++j) {
+            b[i][j] = ' ';
+        }
+    }
+
+    char currentPlayer = PLAYER;
+    char winner = ' ';
+    while (winner == ' ') {
+        Move move;
+        if (currentPlayer == PLAYER) {
+            move = (opponent == 'I') ? getMinimaxPlayerMove(b) : getRandomComputerMove(b);
+        } else {
+            MctsStats stats = {};
+            move = runMCTS(b, iterations, &stats);
+            totals.iterations += stats.iterations;
+            totals.rollouts += stats.rollouts;
+        }
+        b[move.first][move.second] = currentPlayer;
+        winner = checkWinner(b);
+        currentPlayer = (currentPlayer == PLAYER ? COMPUTER : PLAYER);
+    }
+    return winner;
+}
+
+/**
+ * Compare single-threaded MCTS with leaf-parallel MCTS (K rollouts per leaf)
+ * on the same per-move time budget. Each configuration plays `games` games
+ * against a random X and `games` against a perfect X; we report rollout
+ * throughput and the computer's results.
+ */
+void compareLeafParallel(int games, int k, int timeMs) {
+    const MctsOptions saved = mctsOptions;
+    const int configs[2] = { 1, k };
+    const char opponents[2] = { 'R', 'I' };
+
+    cout << "Leaf-parallel comparison: " << games << " games per opponent, "
+         << timeMs << " ms per move, " << getTaskPool().size() + 1
+         << " threads\n";
+    cout << left << setw(6) << "K" << setw(14) << "rollouts/s" << setw(12) << "iters/s"
+         << setw(18) << "vs random W/D/L" << "vs perfect W/D/L\n";
+
+    for (int c = 0; c < 2; ++c) {
+        mctsOptions.leafParallelRollouts = configs[c];
+        mctsOptions.timeBudgetMs = timeMs;
+
+        MctsStats totals = {};
+        int results[2][3] = { { 0, 0, 0 }, { 0, 0, 0 } }; // W/D/L per opponent
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+        for (int o = 0; o < 2; ++o) {
+            for (int g = 0; g < games; ++g) {
+                char winner = playMctsReferenceGame(opponents[o], 0, totals);
+                if (winner == COMPUTER)    results[o][0]++;
+                else if (winner == PLAYER) results[o][2]++;
+                else                       results[o][1]++;
+            }
+        }
+
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        // The reference opponent's thinking time is included in `seconds`;
+        // it is the same for both configurations, so the comparison holds.
+        ostringstream vsRandom, vsPerfect;
+        vsRandom << results[0][0] << "/" << results[0][1] << "/" << results[0][2];
+        vsPerfect << results[1][0] << "/" << results[1][1] << "/" << results[1][2];
+        cout << left << setw(6) << configs[c]
+             << setw(14) << static_cast<long long>(totals.rollouts / seconds)
+             << setw(12) << static_cast<long long>(totals.iterations / seconds)
+             << setw(18) << vsRandom.str() << vsPerfect.str() << "\n";
+    }
+
+    mctsOptions = saved;
+}
+
+// ===============================
+// DIFFICULTY CALIBRATION
+// ===============================
+
+/**
+ * An engine setup whose strength and cost we want to know.
+ */
+struct EngineConfig {
+    char kind;      // 'R' random, 'H' MCTS, 'I' minimax
+    int iterations; // MCTS simulations per move
+};
+
+string describeEngine(const EngineConfig& config) {
+    if (config.kind == 'R') return "random";
+    if (config.kind == 'I') return "minimax";
+    ostringstream name;
+    name << "mcts-" << config.iterations;
+    return name.str();
+}
+
+/**
+ * COMPUTER (O) move for an engine configuration.
+ */
+Move engineMoveFor(const EngineConfig& config, const char b[BOARD_SIZE][BOARD_SIZE]) {
+    if (config.kind == 'I') return findBestMinimaxMove(b);
+    if (config.kind == 'H') return runMCTS(b, config.iterations);
+    return getRandomComputerMove(b);
+}
+
+/**
+ * Move for one of the fixed reference X players: 'R' random, 'N' noisy
+ * (perfect half the time, random otherwise) and 'I' perfect. The perfect
+ * moves are searched without the transposition table, so the reference
+ * players don't warm it for the engine being measured.
+ */
+Move referencePlayerMove(char reference, char b[BOARD_SIZE][BOARD_SIZE]) {
+    if (reference == 'I' || (reference == 'N' && rand() % 2 == 0)) {
+        const bool usedTable = minimaxUsesTable;
+        minimaxUsesTable = false;
+        Move move = getMinimaxPlayerMove(b);
+        minimaxUsesTable = usedTable;
+        return move;
+    }
+    return getRandomComputerMove(b);
+}
+
+/**
+ * Result of measuring one configuration against the reference set.
+ */
+struct CalibrationResult {
+    EngineConfig config;
+    double score;       // mean score over all games (win 1, draw 1/2)
+    double elo;         // Elo difference to the reference set
+    double cpuMsPerMove;
+};
+
+/**
+ * Elo difference implied by an expected score, clamped so that a perfect
+ * score over `games` games stays finite.
+ */
+double eloFromScore(double score, int games) {
+    double margin = 0.5 / max(1, games);
+    score = min(1.0 - margin, max(margin, score));
+    return 400.0 * log10(score / (1.0 - score));
+}
+
+/**
+ * Play `games` games of `config` (as O) against each reference X player and
+ * measure its score and the process CPU time spent in its moves (pool
+ * threads included). The transposition table is cleared first, so every
+ * configuration starts cold and its cost doesn't depend on what ran before.
+ */
+CalibrationResult calibrateEngine(const EngineConfig& config, int games) {
+    const char references[3] = { 'R', 'N', 'I' };
+    double points = 0.0;
+    int played = 0;
+    long long engineMoves = 0;
+    clock_t engineClock = 0;
+
+    if (getTranspositionTable() != NULL) {
+        getTranspositionTable()->clear();
+    }
+
+    for (int r = 0; r < 3; ++r) {
+        for (int g = 0; g < games; ++g) {
+            char b[BOARD_SIZE][BOARD_SIZE];
+            memset(b, ' ', sizeof(b));
+
+            char currentPlayer = PLAYER;
+            char winner = ' ';
+            while (winner == ' ') {
+                Move move;
+                if (currentPlayer == PLAYER) {
+                    move = referencePlayerMove(references[r], b);
+                } else {
+                    clock_t before = clock();
+                    move = engineMoveFor(config, b);
+                    engineClock += clock() - before;
+                    engineMoves++;
+                }
+                b[move.first][move.second] = currentPlayer;
+                winner = checkWinner(b);
+                currentPlayer = (currentPlayer == PLAYER ? COMPUTER : PLAYER);
+            }
+
+            if (winner == COMPUTER)  points += 1.0;
+            else if (winner == 'D')  points += 0.5;
+            played++;
+        }
+    }
+
+    CalibrationResult result;
+    result.config = config;
+    result.score = points / played;
+    result.elo = eloFromScore(result.score, played);
+    result.cpuMsPerMove = engineMoves > 0
+                        ? 1000.0 * engineClock / CLOCKS_PER_SEC / engineMoves : 0.0;
+    return result;
+}
+
+/**
+ * Measure strength against CPU time for a ladder of engine configurations,
+ * then print, for each difficulty level, the cheapest configuration that
+ * reaches its strength target.
+ *
+ * Targets: Regular is whatever costs least; Hard must be at least
+ * `hardElo` against the reference set but still short of Impossible;
+ * Impossible must be within 10 Elo of the strongest configuration measured.
+ */
+void runCalibration(int games, int hardElo) {
+    const int MCTS_LADDER[] = { 100, 300, 1000, 3000, 10000, 30000 };
+    vector<EngineConfig> configs;
+    EngineConfig randomConfig = { 'R', 0 };
+    configs.push_back(randomConfig);
+    for (size_t i = 0; i < sizeof(MCTS_LADDER) / sizeof(MCTS_LADDER[0]); ++i) {
+        EngineConfig mcts = { 'H', MCTS_LADDER[i] };
+        configs.push_back(mcts);
+    }
+    EngineConfig minimaxConfig = { 'I', 0 };
+    configs.push_back(minimaxConfig);
+
+    cout << "Calibration: " << games << " games against each reference X "
+            "(random, noisy-perfect, perfect)\n";
+    cout << left << setw(14) << "engine" << right << setw(9) << "score"
+         << setw(9) << "Elo" << setw(14) << "CPU ms/move" << "\n";
+
+    vector<CalibrationResult> results;
+    for (size_t i = 0; i < configs.size(); ++i) {
+        CalibrationResult r = calibrateEngine(configs[i], games);
+        results.push_back(r);
+        cout << left << setw(14) << describeEngine(r.config) << right << fixed
+             << setw(9) << setprecision(3) << r.score
+             << setw(9) << setprecision(0) << r.elo
+             << setw(14) << setprecision(3) << r.cpuMsPerMove << "\n";
+    }
+
+    double strongest = results[0].elo;
+    for (size_t i = 1; i < results.size(); ++i) {
+        strongest = max(strongest, results[i].elo);
+    }
+
+    struct Target {
+        char choice;
+        const char* name;
+        double minElo;
+        double maxElo; // exclusive; keeps the beatable levels beatable
+    };
+    const double impossibleElo = strongest - 10.0;
+    const Target targets[3] = {
+        { 'R', "Regular",    -1e9,                          impossibleElo },
+        { 'H', "Hard",       static_cast<double>(hardElo),  impossibleElo },
+        { 'I', "Impossible", impossibleElo,                 1e9 },
+    };
+
+    cout << "\nCheapest configuration per difficulty:\n";
+    for (int t = 0; t < 3; ++t) {
+        int best = -1;
+        for (size_t i = 0; i < results.size(); ++i) {
+            if (results[i].elo >= targets[t].minElo && results[i].elo < targets[t].maxElo &&
+                (best < 0 || results[i].cpuMsPerMove < results[best].cpuMsPerMove)) {
+                best = static_cast<int>(i);
+            }
+        }
+        cout << "  " << targets[t].choice << " " << left << setw(11) << targets[t].name << right;
+        if (best < 0) {
+            cout << "no configuration reaches " << setprecision(0) << targets[t].minElo << " Elo\n";
+        } else {
+            cout << describeEngine(results[best].config) << " (" << setprecision(0)
+                 << results[best].elo << " Elo, " << setprecision(3)
+                 << results[best].cpuMsPerMove << " CPU ms/move)\n";
+        }
+    }
+}
+
+/**
+ * Strength of hybrid MCTS as the exact-leaf threshold K and the rollout
+ * search depth vary. Every configuration searches for the same time per
+ * move (mctsOptions.timeBudgetMs, or `timeMs`), so the Elo column compares
+ * strength per CPU-second directly; the CPU column shows what each move
+ * actually cost. Exact leaves are solved through the transposition table,
+ * which calibrateEngine clears for every configuration, so no configuration
+ * inherits solved positions from the ones before it.
+ */
+void runHybridCalibration(int games, int timeMs) {
+    const int EXACT_LADDER[] = { 0, 2, 4, 6, 9 };
+    const int PLIES_LADDER[] = { 0, 1, 2 };
+    const MctsOptions saved = mctsOptions;
+    mctsOptions.timeBudgetMs = timeMs;
+
+    cout << "Hybrid MCTS: " << games << " games against each reference X, "
+         << timeMs << " ms per move\n";
+    cout << right << setw(4) << "K" << setw(7) << "plies" << setw(9) << "score"
+         << setw(9) << "Elo" << setw(14) << "CPU ms/move" << "\n";
+
+    CalibrationResult best;
+    int bestExact = 0;
+    int bestPlies = 0;
+    bool haveBest = false;
+    for (size_t k = 0; k < sizeof(EXACT_LADDER) / sizeof(EXACT_LADDER[0]); ++k) {
+        for (size_t p = 0; p < sizeof(PLIES_LADDER) / sizeof(PLIES_LADDER[0]); ++p) {
+            mctsOptions.exactLeafEmpty = EXACT_LADDER[k];
+            mctsOptions.rolloutPlies = PLIES_LADDER[p];
+            EngineConfig mcts = { 'H', 0 }; // iterations unused on a time budget
+            CalibrationResult r = calibrateEngine(mcts, games);
+            cout << right << setw(4) << EXACT_LADDER[k] << setw(7) << PLIES_LADDER[p] << fixed
+                 << setw(9) << setprecision(3) << r.score
+                 << setw(9) << setprecision(0) << r.elo
+                 << setw(14) << setprecision(3) << r.cpuMsPerMove << "\n";
+            if (!haveBest || r.elo > best.elo) {
+                best = r;
+                bestExact = EXACT_LADDER[k];
+                bestPlies = PLIES_LADDER[p];
+                haveBest = true;
+            }
+        }
+    }
+    cout << "\nStrongest: K=" << bestExact << ", " << bestPlies << " rollout plies ("
+         << setprecision(0) << best.elo << " Elo)\n";
+
+    mctsOptions = saved;
+}
+
+// ===============================
+// SCRIPTED REPLAY
+// ===============================
+
+/**
+ * One game from a move script: the human (X) moves, stored as cells
+ * (row * 3 + column) in a shared array.
+ */
+struct ScriptedGame {
+    int line;      // line number in the script, for reporting
+    int firstMove; // index of the first move in the shared move array
+    int moveCount;
+    bool malformed;
+};
+
+/**
+ * Read a whole file, or stdin for "-", in large chunks.
+ */
+bool readAllInput(const char* path, string& out) {
+    FILE* file = (strcmp(path, "-") == 0) ? stdin : fopen(path, "rb");
+    if (file == NULL) {
+        return false;
+    }
+    char chunk[1 << 16];
+    size_t got;
+    while ((got = fread(chunk, 1, sizeof(chunk), file)) > 0) {
+        out.append(chunk, got);
+    }
+    bool ok = !ferror(file);
+    if (file != stdin) {
+        fclose(file);
+    }
+    return ok;
+}
+
+/**
+ * Parse a move script: one game per line, listing X's moves as row/column
+ * digit pairs. Separators between digits are ignored, so "22 11 33",
+ * "2 2 1 1 3 3" and "2,2 1,1 3,3" are the same game. Blank lines and lines
+ * starting with '#' are skipped.
+ */
+void parseMoveScript(const string& text, vector<ScriptedGame>& games,
+                     vector<unsigned char>& moves) {
+    const char* p = text.data();
+    const char* end = p + text.size();
+    int line = 0;
+
+    while (p < end) {
+        const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+        if (lineEnd == NULL) {
+            lineEnd = end;
+        }
+        line++;
+
+        const char* q = p;
+        while (q < lineEnd && (*q == ' ' || *q == '\t' || *q == '\r')) q++;
+        if (q < lineEnd && *q != '#') {
+            ScriptedGame game = { line, static_cast<int>(moves.size()), 0, false };
+            int pendingRow = -1;
+            for (; q < lineEnd; ++q) {
+                char c = *q;
+                if (c < '0' || c > '9') {
+                    continue; // separator
+                }
+                int value = c - '1';
+                if (value < 0 || value >= BOARD_SIZE) {
+                    game.malformed = true;
+                    break;
+                }
+                if (pendingRow < 0) {
+                    pendingRow = value;
+                } else {
+                    moves.push_back(static_cast<unsigned char>(pendingRow * BOARD_SIZE + value));
+                    game.moveCount++;
+                    pendingRow = -1;
+                }
+            }
+            if (pendingRow >= 0) {
+                game.malformed = true; // odd number of digits
+            }
+            if (game.moveCount > 0 || game.malformed) {
+                games.push_back(game);
+            }
+        }
+        p = lineEnd + 1;
+    }
+}
+
+/**
+ * Play one scripted game against `engine` (as O). Returns 'X', 'O' or 'D'
+ * for finished games, '!' if the script is malformed (including X playing
+ * a cell it already holds), '~' if it diverged (a recorded move lands on a
+ * cell this engine has already taken) and '?' if it runs out of moves first.
+ */
+char playScriptedGame(const ScriptedGame& game, const unsigned char* moves, char engine) {
+    if (game.malformed) {
+        return '!';
+    }
+
+    char b[BOARD_SIZE][BOARD_SIZE];
+    memset(b, ' ', sizeof(b));
+    EngineConfig config = { engine, getMctsIterationsForDifficulty(engine) };
+
+    unsigned char played[BOARD_SIZE * BOARD_SIZE];
+    int playedCount = 0;
+    int next = 0;
+    char currentPlayer = PLAYER;
+    char winner = ' ';
+    while (winner == ' ') {
+        int cell;
+        if (currentPlayer == PLAYER) {
+            if (next == game.moveCount) {
+                return '?';
+            }
+            cell = moves[game.firstMove + next++];
+            if (b[cell / BOARD_SIZE][cell % BOARD_SIZE] == PLAYER) {
+                return '!';
+            }
+            if (b[cell / BOARD_SIZE][cell % BOARD_SIZE] == COMPUTER) {
+                return '~';
+            }
+        } else {
+            Move move = engineMoveFor(config, b);
+            cell = move.first * BOARD_SIZE + move.second;
+        }
+        b[cell / BOARD_SIZE][cell % BOARD_SIZE] = currentPlayer;
+        played[playedCount++] = static_cast<unsigned char>(cell);
+        winner = checkWinner(b);
+        currentPlayer = (currentPlayer == PLAYER ? COMPUTER : PLAYER);
+    }
+
+    if (gameLogger != NULL) {
+        gameLogger->log(makeGameRecord('P', engine, winner, played, playedCount));
+    }
+    return winner;
+}
+
+/**
+ * Replay every game in a move script against `engine`, spread over the
+ * task pool, and print a summary. Returns false if the script can't be read.
+ */
+bool runReplay(const char* path, char engine) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    string text;
+    if (!readAllInput(path, text)) {
+        cout << "Could not read move script: " << path << "\n";
+        return false;
+    }
+    vector<ScriptedGame> games;
+    vector<unsigned char> moves;
+    parseMoveScript(text, games, moves);
+    long long parseUs = elapsedMicros(start);
+
+    // Results per game, filled in parallel and summarised in script order.
+    vector<char> results(games.size());
+    const size_t CHUNK = 64;
+    {
+        TaskGroup group(getTaskPool());
+        for (size_t first = 0; first < games.size(); first += CHUNK) {
+            size_t last = min(games.size(), first + CHUNK);
+            group.run([&, first, last]() {
+                for (size_t g = first; g < last; ++g) {
+                    results[g] = playScriptedGame(games[g], moves.data(), engine);
+                }
+            });
+        }
+        group.wait();
+    }
+    double seconds = elapsedMicros(start) / 1e6;
+
+    long long xWins = 0, draws = 0, oWins = 0, malformed = 0, diverged = 0, incomplete = 0;
+    vector<int> lostLines; // games the engine lost are the interesting ones
+    for (size_t g = 0; g < games.size(); ++g) {
+        switch (results[g]) {
+            case PLAYER:
+                xWins++;
+                if (lostLines.size() < 10) lostLines.push_back(games[g].line);
+                break;
+            case COMPUTER: oWins++; break;
+            case 'D':      draws++; break;
+            case '!':      malformed++; break;
+            case '~':      diverged++; break;
+            default:       incomplete++; break;
+        }
+    }
+
+    cout << "Replayed " << games.size() << " scripted games against engine " << engine
+         << " (parsed in " << parseUs / 1000.0 << " ms)\n"
+         << "X wins / draws / O wins: " << xWins << " / " << draws << " / " << oWins << "\n"
+         << "Diverged from the script: " << diverged << ", incomplete: " << incomplete
+         << ", malformed lines: " << malformed << "\n";
+    if (!lostLines.empty()) {
+        cout << "Engine lost on line(s):";
+        for (size_t i = 0; i < lostLines.size(); ++i) {
+            cout << " " << lostLines[i];
+        }
+        cout << (xWins > static_cast<long long>(lostLines.size()) ? " ...\n" : "\n");
+    }
+    cout << fixed << setprecision(3) << "Elapsed: " << seconds << " s ("
+         << setprecision(0) << (seconds > 0 ? games.size() / seconds : 0.0) << " games/s)\n";
+    return true;
+}
+
+// ===============================
+// PERFECT PLAY TABLE
+// ===============================
+
+// Game-theoretic value of every reachable position, indexed by
+// PositionKey: +1 X wins, 0 draw, -1 O wins.
+signed char perfectValues[POSITION_COUNT];
+// Plies to the end of the game under perfect play (winner hurries, loser
+// stalls); -1 for positions that can't arise in a game.
+signed char perfectDepths[POSITION_COUNT];
+once_flag perfectTableOnce;
+
+/**
+ * Fill the table for `b` (whose key is `key`) and everything reachable
+ * from it.
+ */
+void solvePosition(char b[BOARD_SIZE][BOARD_SIZE], PositionKey key, char toMove) {
+    if (perfectDepths[key.code] >= 0) {
+        return;
+    }
+
+    char winner = checkWinner(b);
+    if (winner != ' ') {
+        perfectValues[key.code] = (winner == PLAYER) ? 1 : (winner == COMPUTER) ? -1 : 0;
+        perfectDepths[key.code] = 0;
+        return;
+    }
+
+    const int sign = (toMove == PLAYER) ? 1 : -1; // the mover wants sign * value high
+    int bestValue = -2;
+    int bestDepth = 0;
+    for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE; ++cell) {
+        char& c = b[cell / BOARD_SIZE][cell % BOARD_SIZE];
+        if (c != ' ') {
+            continue;
+        }
+        c = toMove;
+        PositionKey child = key.withMove(cell, toMove);
+        solvePosition(b, child, toMove == PLAYER ? COMPUTER : PLAYER);
+        c = ' ';
+
+        int value = sign * perfectValues[child.code];
+        int depth = perfectDepths[child.code] + 1;
+        // Prefer better values; among wins the fastest, among the rest the slowest.
+        if (value > bestValue ||
+            (value == bestValue && (value > 0 ? depth < bestDepth : depth > bestDepth))) {
+            bestValue = value;
+            bestDepth = depth;
+        }
+    }
+    perfectValues[key.code] = static_cast<signed char>(sign * bestValue);
+    perfectDepths[key.code] = static_cast<signed char>(bestDepth);
+}
+
+void buildPerfectTable() {
+    call_once(perfectTableOnce, []() {
+        memset(perfectDepths, -1, sizeof(perfectDepths));
+        char b[BOARD_SIZE][BOARD_SIZE];
+        memset(b, ' ', sizeof(b));
+        solvePosition(b, PositionKey::fromCode(0), PLAYER);
+    });
+}
+
+/**
+ * Whether `key` is in range and can arise in a game (one of the 5478
+ * legal positions).
+ */
+bool isReachable(PositionKey key) {
+    buildPerfectTable();
+    return key.inRange() && perfectDepths[key.code] >= 0;
+}
+
+/**
+ * Exact value of a reachable position: +1 X wins, 0 draw, -1 O wins.
+ */
+int perfectValue(PositionKey key) {
+    buildPerfectTable();
+    return perfectValues[key.code];
+}
+
+/**
+ * Plies left under perfect play; 0 once the game is over.
+ */
+int perfectDepth(PositionKey key) {
+    buildPerfectTable();
+    return perfectDepths[key.code];
+}
+
+/**
+ * Bitmask of the cells (row * 3 + column) that keep the best value for
+ * the side to move.
+ */
+int perfectMoveMask(PositionKey key) {
+    buildPerfectTable();
+    char mover = key.sideToMove();
+    int target = perfectValues[key.code];
+    int mask = 0;
+    for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE; ++cell) {
+        if (key.digit(cell) == 0 && perfectValues[key.withMove(cell, mover).code] == target) {
+            mask |= 1 << cell;
+        }
+    }
+    return mask;
+}
+
+// ===============================
+// BLUNDER ANALYSIS
+// ===============================
+
+/**
+ * Running totals for one kind of player on one side.
+ */
+struct BlunderTally {
+    long long moves;
+    long long winToDraw;
+    long long winToLoss;
+    long long drawToLoss;
+};
+
+/**
+ * Cell list "(r,c) (r,c)" for a move mask.
+ */
+string describeCells(int mask) {
+    string out;
+    for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE; ++cell) {
+        if (mask & (1 << cell)) {
+            if (!out.empty()) out += ' ';
+            out += '(';
+            out += static_cast<char>('1' + cell / BOARD_SIZE);
+            out += ',';
+            out += static_cast<char>('1' + cell % BOARD_SIZE);
+            out += ')';
+        }
+    }
+    return out;
+}
+
+const char* valueName(int valueForMover) {
+    return valueForMover > 0 ? "win" : valueForMover < 0 ? "loss" : "draw";
+}
+
+/**
+ * Re-evaluate every move of one logged game against the perfect-play
+ * table. Blunders (moves that lowered the mover's game-theoretic value)
+ * are appended to `report`; per-side totals go into `tallies`, indexed by
+ * side (0 = X, 1 = O) and player kind.
+ * Returns false for a line that isn't a game record.
+ */
+bool analyseLoggedGame(const char* line, const char* lineEnd, long long lineNumber,
+                       string& report, BlunderTally tallies[2][128]) {
+    // <unix ms> <X player> <O player> <winner> <moves...>
+    const char* p = line;
+    while (p < lineEnd && *p != ' ') p++;           // timestamp
+    if (lineEnd - p < 6) return false;
+    char kinds[2] = { p[1], p[3] };
+    p += 6;                                         // " X O W"
+
+    PositionKey key = PositionKey::fromCode(0);
+    char mover = PLAYER;
+    int ply = 0;
+
+    while (p < lineEnd) {
+        while (p < lineEnd && *p == ' ') p++;
+        if (lineEnd - p < 2) break;
+        int row = p[0] - '1';
+        int col = p[1] - '1';
+        p += 2;
+        if (row < 0 || row >= BOARD_SIZE || col < 0 || col >= BOARD_SIZE ||
+            key.digit(row * BOARD_SIZE + col) != 0 || perfectDepth(key) == 0) {
+            return false;
+        }
+
+        const int sign = (mover == PLAYER) ? 1 : -1;
+        int before = sign * perfectValue(key);
+        int bestMask = (before != -1) ? perfectMoveMask(key) : 0;
+        key = key.withMove(row * BOARD_SIZE + col, mover);
+        int after = sign * perfectValue(key);
+        ply++;
+
+        int side = (mover == PLAYER) ? 0 : 1;
+        BlunderTally& tally = tallies[side][kinds[side] & 127];
+        tally.moves++;
+        if (after < before) {
+            if (before > 0 && after == 0) tally.winToDraw++;
+            else if (before > 0)          tally.winToLoss++;
+            else                          tally.drawToLoss++;
+
+            char buffer[32];
+            report += "line ";
+            report.append(buffer, to_chars(buffer, buffer + sizeof(buffer), lineNumber).ptr);
+            report += " ply ";
+            report.append(buffer, to_chars(buffer, buffer + sizeof(buffer), ply).ptr);
+            report += ' ';
+            report += mover;
+            report += '[';
+            report += kinds[side];
+            report += "] (";
+            report += static_cast<char>('1' + row);
+            report += ',';
+            report += static_cast<char>('1' + col);
+            report += ") ";
+            report += valueName(before);
+            report += " -> ";
+            report += valueName(after);
+            report += ", best: ";
+            report += describeCells(bestMask);
+            report += '\n';
+        }
+        mover = (mover == PLAYER) ? COMPUTER : PLAYER;
+    }
+    return true;
+}
+
+/**
+ * Scan a game log (the --log-games format) and flag every move that
+ * changed the game-theoretic value. Chunks of games are analysed in
+ * parallel on the task pool and their findings streamed to stdout as each
+ * chunk completes, so the output is not in file order; every line carries
+ * its line number.
+ */
+bool runBlunderAnalysis(const char* path) {
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    buildPerfectTable();
+
+    string text;
+    if (!readAllInput(path, text)) {
+        cout << "Could not read game log: " << path << "\n";
+        return false;
+    }
+
+    // Split into chunks of whole lines.
+    const size_t CHUNK_BYTES = 1 << 20;
+    vector<size_t> chunkStarts;
+    for (size_t offset = 0; offset < text.size(); ) {
+        chunkStarts.push_back(offset);
+        size_t next = min(text.size(), offset + CHUNK_BYTES);
+        const void* newline = memchr(text.data() + next, '\n', text.size() - next);
+        offset = (newline == NULL) ? text.size()
+                                   : static_cast<const char*>(newline) - text.data() + 1;
+    }
+
+    // Line numbers at chunk starts, so findings can name their line.
+    vector<long long> chunkFirstLine(chunkStarts.size(), 1);
+    for (size_t c = 1; c < chunkStarts.size(); ++c) {
+        chunkFirstLine[c] = chunkFirstLine[c - 1] +
+            count(text.begin() + chunkStarts[c - 1], text.begin() + chunkStarts[c], '\n');
+    }
+
+    mutex outputMutex;
+    BlunderTally totals[2][128];
+    memset(totals, 0, sizeof(totals));
+    long long games = 0, skipped = 0;
+
+    TaskGroup group(getTaskPool());
+    for (size_t c = 0; c < chunkStarts.size(); ++c) {
+        group.run([&, c]() {
+            const char* p = text.data() + chunkStarts[c];
+            const char* end = text.data() +
+                (c + 1 < chunkStarts.size() ? chunkStarts[c + 1] : text.size());
+            BlunderTally tallies[2][128];
+            memset(tallies, 0, sizeof(tallies));
+            string report;
+            long long lineNumber = chunkFirstLine[c];
+            long long chunkGames = 0, chunkSkipped = 0;
+
+            while (p < end) {
+                const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+                if (lineEnd == NULL) lineEnd = end;
+                if (lineEnd > p && *p != '#') {
+                    if (analyseLoggedGame(p, lineEnd, lineNumber, report, tallies)) chunkGames++;
+                    else chunkSkipped++;
+                }
+                p = lineEnd + 1;
+                lineNumber++;
+            }
+
+            lock_guard<mutex> lock(outputMutex);
+            cout << report << flush;
+            games += chunkGames;
+            skipped += chunkSkipped;
+            for (int side = 0; side < 2; ++side) {
+                for (int kind = 0; kind < 128; ++kind) {
+                    totals[side][kind].moves      += tallies[side][kind].moves;
+                    totals[side][kind].winToDraw  += tallies[side][kind].winToDraw;
+                    totals[side][kind].winToLoss  += tallies[side][kind].winToLoss;
+                    totals[side][kind].drawToLoss += tallies[side][kind].drawToLoss;
+                }
+            }
+        });
+    }
+    group.wait();
+
+    cout << "\nAnalysed " << games << " games";
+    if (skipped > 0) {
+        cout << " (" << skipped << " unreadable lines skipped)";
+    }
+    cout << " in " << fixed << setprecision(3) << elapsedMicros(start) / 1e6 << " s\n";
+    cout << left << setw(10) << "player" << right << setw(12) << "moves" << setw(12) << "win->draw"
+         << setw(12) << "win->loss" << setw(12) << "draw->loss" << setw(12) << "blunder %" << "\n";
+    for (int side = 0; side < 2; ++side) {
+        for (int kind = 0; kind < 128; ++kind) {
+            const BlunderTally& t = totals[side][kind];
+            if (t.moves == 0) continue;
+            string label = string(1, side == 0 ? PLAYER : COMPUTER) + " [" + static_cast<char>(kind) + "]";
+            long long blunders = t.winToDraw + t.winToLoss + t.drawToLoss;
+            cout << left << setw(10) << label << right << setw(12) << t.moves
+                 << setw(12) << t.winToDraw << setw(12) << t.winToLoss << setw(12) << t.drawToLoss
+                 << setw(12) << setprecision(2) << 100.0 * blunders / t.moves << "\n";
+        }
+    }
+    return true;
+}
+
+// ===============================
+// SHARED-MEMORY ENGINE SERVER
+// ===============================
+
+/**
+ * One position query. `engine` picks who answers: 'I' the perfect-play
+ * table, 'H' MCTS at the hard iteration count, 'R' a random move.
+ */
+struct ShmRequest {
+    uint64_t id;
+    PositionKey position;
+    uint16_t reserved;
+    uint32_t engine;
+};
+
+/**
+ * Answer to a ShmRequest. `move` is row * 3 + column (255 when the game is
+ * already over) and `value` the perfect-play value for X (+1, 0, -1).
+ */
+struct ShmResponse {
+    uint64_t id;
+    uint8_t move;
+    int8_t value;
+    uint8_t status;   // SHM_OK or SHM_BAD_POSITION
+    uint8_t reserved[5];
+};
+
+enum { SHM_OK = 0, SHM_BAD_POSITION = 1 };
+
+#ifdef __linux__
+
+/**
+ * Single-producer/single-consumer ring living in shared memory. `head` and
+ * `tail` are free-running counters on their own cache lines and double as
+ * futex words: a side that finds the ring empty (or full) raises its
+ * waiter flag, re-checks, and sleeps on the counter the other side will
+ * advance. The other side only pays for a FUTEX_WAKE when the flag is set,
+ * so a busy ring never enters the kernel.
+ */
+template <typename T, uint32_t CAPACITY>
+struct ShmRing {
+    static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+    alignas(64) atomic<uint32_t> head;        // next slot to read
+    atomic<uint32_t> producerWaiting;         // producer sleeps on head
+    alignas(64) atomic<uint32_t> tail;        // next slot to write
+    atomic<uint32_t> consumerWaiting;         // consumer sleeps on tail
+    alignas(64) T slots[CAPACITY];
+
+    /**
+     * Copy up to `count` items in; returns how many fit.
+     */
+    uint32_t push(const T* items, uint32_t count) {
+        uint32_t t = tail.load(memory_order_relaxed);
+        uint32_t room = CAPACITY - (t - head.load(memory_order_acquire));
+        count = min(count, room);
+        for (uint32_t i = 0; i < count; ++i) {
+            slots[(t + i) & (CAPACITY - 1)] = items[i];
+        }
+        if (count > 0) {
+            tail.store(t + count, memory_order_seq_cst);
+            if (consumerWaiting.load(memory_order_seq_cst)) {
+                futexWake(tail);
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Copy up to `max` items out; returns how many were available.
+     */
+    uint32_t pop(T* items, uint32_t max) {
+        uint32_t h = head.load(memory_order_relaxed);
+        uint32_t count = min(max, tail.load(memory_order_acquire) - h);
+        for (uint32_t i = 0; i < count; ++i) {
+            items[i] = slots[(h + i) & (CAPACITY - 1)];
+        }
+        if (count > 0) {
+            head.store(h + count, memory_order_seq_cst);
+            if (producerWaiting.load(memory_order_seq_cst)) {
+                futexWake(head);
+            }
+        }
+        return count;
+    }
+
+    /**
+     * Sleep until there is something to pop. Returns false if interrupted
+     * by a signal.
+     */
+    bool waitForItems() {
+        return waitWhile(tail, consumerWaiting, [this](uint32_t t) {
+            return t == head.load(memory_order_relaxed);
+        });
+    }
+
+    /**
+     * Sleep until there is room to push.
+     */
+    bool waitForRoom() {
+        return waitWhile(head, producerWaiting, [this](uint32_t h) {
+            return tail.load(memory_order_relaxed) - h == CAPACITY;
+        });
+    }
+
+private:
+    static void futexWake(atomic<uint32_t>& word) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+    }
+
+    template <typename Blocked>
+    static bool waitWhile(atomic<uint32_t>& word, atomic<uint32_t>& waiting, Blocked blocked) {
+        // Spin briefly first: a busy peer usually answers within microseconds.
+        for (int spin = 0; spin < 256; ++spin) {
+            if (!blocked(word.load(memory_order_acquire))) return true;
+        }
+        while (true) {
+            waiting.store(1, memory_order_seq_cst);
+            uint32_t seen = word.load(memory_order_seq_cst);
+            if (!blocked(seen)) {
+                waiting.store(0, memory_order_relaxed);
+                return true;
+            }
+            long rc = syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT, seen, NULL, NULL, 0);
+            waiting.store(0, memory_order_relaxed);
+            if (rc != 0 && errno == EINTR) return false;
+        }
+    }
+};
+
+const uint32_t SHM_MAGIC = 0x54545452; // "TTTR"
+const uint32_t SHM_VERSION = 2;        // 2: requests carry a PositionKey
+const uint32_t SHM_RING_SIZE = 4096;
+
+/**
+ * The whole shared region: a request ring written by the client and a
+ * response ring written by the server. One client per channel.
+ */
+struct ShmChannel {
+    atomic<uint32_t> magic;   // set last by the server once the rings are ready
+    uint32_t version;
+    ShmRing<ShmRequest, SHM_RING_SIZE> requests;
+    ShmRing<ShmResponse, SHM_RING_SIZE> responses;
+};
+
+/**
+ * Map the channel `name` (a POSIX shared-memory object, e.g. "/ttt").
+ * The server creates and sizes it; clients attach to an existing one.
+ */
+ShmChannel* mapShmChannel(const char* name, bool create) {
+    int fd = create ? shm_open(name, O_CREAT | O_RDWR | O_TRUNC, S_IRUSR | S_IWUSR)
+                    : shm_open(name, O_RDWR, 0);
+    if (fd < 0) {
+        return NULL;
+    }
+    if (create && ftruncate(fd, sizeof(ShmChannel)) != 0) {
+        close(fd);
+        return NULL;
+    }
+    void* memory = mmap(NULL, sizeof(ShmChannel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (memory == MAP_FAILED) {
+        return NULL;
+    }
+    ShmChannel* channel = static_cast<ShmChannel*>(memory);
+    if (!create && (channel->magic.load(memory_order_acquire) != SHM_MAGIC || channel->version != SHM_VERSION)) {
+        munmap(memory, sizeof(ShmChannel));
+        return NULL;
+    }
+    return channel;
+}
+
+volatile sig_atomic_t shmStopRequested = 0;
+
+void requestShmStop(int) {
+    shmStopRequested = 1;
+}
+
+ShmResponse answerShmRequest(const ShmRequest& request) {
+    ShmResponse response = {};
+    response.id = request.id;
+    response.move = 255;
+    PositionKey key = request.position;
+    if (!isReachable(key)) {
+        response.status = SHM_BAD_POSITION;
+        return response;
+    }
+    response.value = static_cast<int8_t>(perfectValue(key));
+    if (perfectDepth(key) == 0) {
+        return response;
+    }
+
+    if (request.engine == 'I') {
+        response.move = static_cast<uint8_t>(__builtin_ctz(perfectMoveMask(key)));
+        return response;
+    }
+    // runMCTS and the random player always play COMPUTER; flip the marks
+    // when X is to move so the answer is for the right side.
+    char b[BOARD_SIZE][BOARD_SIZE];
+    key.toBoard(b);
+    if (key.sideToMove() == PLAYER) {
+        for (int i = 0; i < BOARD_SIZE; ++i) {
+            for (int j = 0; j < BOARD_SIZE; ++j) {
+                if (b[i][j] != ' ') b[i][j] = (b[i][j] == PLAYER) ? COMPUTER : PLAYER;
+            }
+        }
+    }
+    Move move = (request.engine == 'H')
+        ? runMCTS(b, getMctsIterationsForDifficulty('H'))
+        : getRandomComputerMove(b);
+    response.move = static_cast<uint8_t>(move.first * BOARD_SIZE + move.second);
+    return response;
+}
+
+/**
+ * Serve position queries over shared memory until SIGINT/SIGTERM.
+ * Requests are drained and answered in batches, so the ring cost is a
+ * few atomic operations per batch rather than per query.
+ */
+bool runShmServer(const char* name) {
+    buildPerfectTable();
+    ShmChannel* channel = mapShmChannel(name, true);
+    if (channel == NULL) {
+        cout << "Could not create shared memory channel " << name << "\n";
+        return false;
+    }
+    new (&channel->requests) ShmRing<ShmRequest, SHM_RING_SIZE>();
+    new (&channel->responses) ShmRing<ShmResponse, SHM_RING_SIZE>();
+    channel->version = SHM_VERSION;
+    channel->magic.store(SHM_MAGIC, memory_order_release);
+
+    struct sigaction action = {};
+    action.sa_handler = requestShmStop;  // no SA_RESTART: FUTEX_WAIT returns EINTR
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    cout << "Serving positions on shared memory " << name << " (Ctrl-C to stop)\n" << flush;
+
+    const uint32_t BATCH = 256;
+    ShmRequest requests[BATCH];
+    ShmResponse responses[BATCH];
+    long long served = 0;
+    while (!shmStopRequested) {
+        uint32_t count = channel->requests.pop(requests, BATCH);
+        if (count == 0) {
+            channel->requests.waitForItems();
+            continue;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            responses[i] = answerShmRequest(requests[i]);
+        }
+        uint32_t sent = 0;
+        while (sent < count && !shmStopRequested) {
+            sent += channel->responses.push(responses + sent, count - sent);
+            if (sent < count) channel->responses.waitForRoom();
+        }
+        served += count;
+    }
+
+    channel->magic.store(0, memory_order_release);
+    munmap(channel, sizeof(ShmChannel));
+    shm_unlink(name);
+    cout << "Served " << served << " queries\n";
+    return true;
+}
+
+/**
+ * Client benchmark: keep the request ring full of random reachable
+ * positions, check each 'I' answer against the local perfect-play table
+ * and report throughput.
+ */
+bool runShmBenchmark(const char* name, long long queries, char engine) {
+    buildPerfectTable();
+    ShmChannel* channel = mapShmChannel(name, false);
+    if (channel == NULL) {
+        cout << "No engine server on shared memory " << name << "\n";
+        return false;
+    }
+
+    vector<PositionKey> positions;
+    for (int code = 0; code < POSITION_COUNT; ++code) {
+        if (isReachable(PositionKey::fromCode(code))) positions.push_back(PositionKey::fromCode(code));
+    }
+
+    const uint32_t BATCH = 256;
+    ShmRequest requests[BATCH];
+    ShmResponse responses[BATCH];
+    long long sent = 0, received = 0, wrong = 0;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    while (received < queries) {
+        uint32_t want = static_cast<uint32_t>(min<long long>(BATCH, queries - sent));
+        for (uint32_t i = 0; i < want; ++i) {
+            requests[i].id = sent + i;
+            requests[i].position = positions[(sent + i) * 2654435761u % positions.size()];
+            requests[i].reserved = 0;
+            requests[i].engine = static_cast<uint32_t>(engine);
+        }
+        sent += channel->requests.push(requests, want);
+
+        uint32_t count = channel->responses.pop(responses, BATCH);
+        if (count == 0 && (want == 0 || sent - received >= SHM_RING_SIZE)) {
+            if (!channel->responses.waitForItems()) break;
+            continue;
+        }
+        for (uint32_t i = 0; i < count; ++i) {
+            const ShmResponse& r = responses[i];
+            PositionKey key = positions[r.id * 2654435761u % positions.size()];
+            bool ok = r.status == SHM_OK && r.value == perfectValue(key);
+            if (engine == 'I' && ok && r.move != 255) {
+                ok = (perfectMoveMask(key) >> r.move) & 1;
+            }
+            if (!ok) wrong++;
+        }
+        received += count;
+    }
+
+    double seconds = elapsedMicros(start) / 1e6;
+    munmap(channel, sizeof(ShmChannel));
+    cout << "Answered " << received << " queries in " << fixed << setprecision(3) << seconds << " s ("
+         << setprecision(0) << received / max(seconds, 1e-9) << " queries/s, "
+         << setprecision(1) << 1e9 * seconds / max<long long>(received, 1) << " ns/query), "
+         << wrong << " mismatches\n";
+    return wrong == 0;
+}
+
+#else
+
+bool runShmServer(const char*) {
+    cout << "Shared-memory serving needs Linux.\n";
+    return false;
+}
+
+bool runShmBenchmark(const char*, long long, char) {
+    cout << "Shared-memory serving needs Linux.\n";
+    return false;
+}
+
+#endif
+
+// ===============================
+// POSITION DATASET EXPORT
+// ===============================
+
+/*
+ * Dataset file layout (native byte order, everything 64-byte aligned so
+ * each column can be mapped straight into an array):
+ *
+ *   DatasetHeader
+ *   DatasetColumn[columns]
+ *   column 0 data (rows * width bytes), column 1 data, ...
+ *
+ * Rows are ordered by ply, then by position key.
+ */
+struct DatasetHeader {
+    char magic[4];      // "TTTD"
+    uint32_t version;   // 1
+    uint64_t rows;
+    uint32_t columns;
+    uint32_t boardSize;
+    uint8_t reserved[40];
+};
+
+struct DatasetColumn {
+    char name[16];      // NUL-padded
+    char type;          // 'u' unsigned or 'i' signed integer
+    uint8_t width;      // bytes per element
+    uint8_t reserved[6];
+    uint64_t offset;    // from the start of the file
+    uint64_t bytes;
+    uint8_t reserved2[24];
+};
+
+/**
+ * Enumerate every reachable position with at most `maxPly` marks, label
+ * it from the perfect-play table and write the columnar file at `path`.
+ */
+bool exportPositionDataset(const char* path, int maxPly) {
+    buildPerfectTable();
+
+    vector<uint32_t> keys;
+    vector<uint8_t> plies;
+    for (int ply = 0; ply <= min(maxPly, BOARD_SIZE * BOARD_SIZE); ++ply) {
+        for (int code = 0; code < POSITION_COUNT; ++code) {
+            PositionKey key = PositionKey::fromCode(code);
+            if (isReachable(key) && key.marks() == ply) {
+                keys.push_back(code);
+                plies.push_back(static_cast<uint8_t>(ply));
+            }
+        }
+    }
+
+    size_t rows = keys.size();
+    vector<uint8_t> sides(rows), depths(rows);
+    vector<int8_t> values(rows);
+    vector<uint16_t> bestMasks(rows), classes(rows);
+    vector<uint32_t> canonical(rows);
+    vector<int> classIndex(POSITION_COUNT, -1);
+    int classCount = 0;
+    for (size_t i = 0; i < rows; ++i) {
+        PositionKey key = PositionKey::fromCode(keys[i]);
+        bool over = perfectDepth(key) == 0;
+        sides[i] = key.sideToMove();
+        values[i] = static_cast<int8_t>(perfectValue(key));
+        depths[i] = static_cast<uint8_t>(perfectDepth(key));
+        bestMasks[i] = over ? 0 : static_cast<uint16_t>(perfectMoveMask(key));
+        canonical[i] = key.canonical().code;
+        if (classIndex[canonical[i]] < 0) classIndex[canonical[i]] = classCount++;
+        classes[i] = static_cast<uint16_t>(classIndex[canonical[i]]);
+    }
+
+    struct ColumnSource { const char* name; char type; int width; const void* data; };
+    const ColumnSource sources[] = {
+        { "key",       'u', 4, keys.data() },
+        { "ply",       'u', 1, plies.data() },
+        { "side",      'u', 1, sides.data() },
+        { "value",     'i', 1, values.data() },
+        { "best_mask", 'u', 2, bestMasks.data() },
+        { "depth",     'u', 1, depths.data() },
+        { "canonical", 'u', 4, canonical.data() },
+        { "sym_class", 'u', 2, classes.data() },
+    };
+    const int COLUMNS = sizeof(sources) / sizeof(sources[0]);
+
+    DatasetHeader header = {};
+    memcpy(header.magic, "TTTD", 4);
+    header.version = 1;
+    header.rows = rows;
+    header.columns = COLUMNS;
+    header.boardSize = BOARD_SIZE;
+
+    DatasetColumn columns[COLUMNS] = {};
+    uint64_t offset = sizeof(DatasetHeader) + sizeof(columns);
+    for (int c = 0; c < COLUMNS; ++c) {
+        strncpy(columns[c].name, sources[c].name, sizeof(columns[c].name) - 1);
+        columns[c].type = sources[c].type;
+        columns[c].width = static_cast<uint8_t>(sources[c].width);
+        columns[c].offset = (offset + 63) & ~uint64_t(63);
+        columns[c].bytes = rows * sources[c].width;
+        offset = columns[c].offset + columns[c].bytes;
+    }
+
+    FILE* file = fopen(path, "wb");
+    if (file == NULL) {
+        cout << "Could not write dataset: " << path << "\n";
+        return false;
+    }
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+              fwrite(columns, sizeof(columns), 1, file) == 1;
+    uint64_t written = sizeof(header) + sizeof(columns);
+    static const char padding[64] = {};
+    for (int c = 0; c < COLUMNS && ok; ++c) {
+        ok = fwrite(padding, 1, columns[c].offset - written, file) == columns[c].offset - written &&
+             fwrite(sources[c].data, 1, columns[c].bytes, file) == columns[c].bytes;
+        written = columns[c].offset + columns[c].bytes;
+    }
+    ok = (fclose(file) == 0) && ok;
+    if (!ok) {
+        cout << "Could not write dataset: " << path << "\n";
+        return false;
+    }
+
+    long long xWins = count(values.begin(), values.end(), 1);
+    long long oWins = count(values.begin(), values.end(), -1);
+    cout << "Wrote " << rows << " positions (" << classCount << " symmetry classes; "
+         << xWins << " X wins, " << rows - xWins - oWins << " draws, " << oWins
+         << " O wins) in " << COLUMNS << " columns, " << written << " bytes, to " << path << "\n";
+    return true;
+}
+
+// ===============================
+// C ABI
+// ===============================
+
+// Implementations of the functions declared in tictactoe.h, all answered
+// from the perfect-play table.
+
+extern "C" {
+
+int ttt_abi_version(void) {
+    return TTT_ABI_VERSION;
+}
+
+uint32_t ttt_encode(const char cells[9]) {
+    char b[BOARD_SIZE][BOARD_SIZE];
+    for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE; ++cell) {
+        b[cell / BOARD_SIZE][cell % BOARD_SIZE] =
+            static_cast<char>(toupper(static_cast<unsigned char>(cells[cell])));
+    }
+    return PositionKey::fromBoard(b).code;
+}
+
+int ttt_decode(uint32_t position, char cells[9]) {
+    PositionKey key = PositionKey::fromCode(position);
+    if (position >= static_cast<uint32_t>(POSITION_COUNT)) {
+        return TTT_INVALID_POSITION;
+    }
+    for (int cell = 0; cell < BOARD_SIZE * BOARD_SIZE; ++cell) {
+        cells[cell] = key.mark(cell);
+    }
+    return 0;
+}
+
+int ttt_analyze(uint32_t position, ttt_result* result) {
+    PositionKey key = PositionKey::fromCode(position);
+    memset(result, 0, sizeof(*result));
+    if (position >= static_cast<uint32_t>(POSITION_COUNT) || !isReachable(key)) {
+        result->value = TTT_INVALID_POSITION;
+        result->best_move = TTT_INVALID_POSITION;
+        return TTT_INVALID_POSITION;
+    }
+    result->value = static_cast<int8_t>(perfectValue(key));
+    result->depth = static_cast<uint8_t>(perfectDepth(key));
+    result->side = static_cast<uint8_t>(key.sideToMove());
+    if (result->depth == 0) {
+        result->best_move = TTT_GAME_OVER;
+        return result->value;
+    }
+    int mask = perfectMoveMask(key);
+    result->best_mask = static_cast<uint16_t>(mask);
+    result->best_move = static_cast<int8_t>(__builtin_ctz(mask));
+    return result->value;
+}
+
+int ttt_evaluate(uint32_t position) {
+    PositionKey key = PositionKey::fromCode(position);
+    if (position >= static_cast<uint32_t>(POSITION_COUNT) || !isReachable(key)) {
+        return TTT_INVALID_POSITION;
+    }
+    return perfectValue(key);
+}
+
+int ttt_best_move(uint32_t position) {
+    ttt_result result;
+    ttt_analyze(position, &result);
+    return result.best_move;
+}
+
+void ttt_encode_batch(const char* cells, uint32_t* positions, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        positions[i] = ttt_encode(cells + i * BOARD_SIZE * BOARD_SIZE);
+    }
+}
+
+void ttt_evaluate_batch(const uint32_t* positions, int8_t* values, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = static_cast<int8_t>(ttt_evaluate(positions[i]));
+    }
+}
+
+void ttt_best_move_batch(const uint32_t* positions, int8_t* moves, size_t count) {
+    ttt_result result;
+    for (size_t i = 0; i < count; ++i) {
+        ttt_analyze(positions[i], &result);
+        moves[i] = result.best_move;
     }
 }
 
-void printBoard() {
-    cout << "\n    1   2   3\n";
-    cout << "  +---+---+---+\n";
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        cout << i + 1 << " | ";
-        for (int j = 0; j < BOARD_SIZE; ++j) {
-            cout << board[i][j] << " | ";
-        }
-        cout << "\n";
-        cout << "  +---+---+---+\n";
+void ttt_analyze_batch(const uint32_t* positions, ttt_result* results, size_t count) {
+    for (size_t i = 0; i < count; ++i) {
+        ttt_analyze(positions[i], &results[i]);
     }
 }
 
+} // extern "C"
+
+// ===============================
+// BENCHMARKS
+// ===============================
+
 /**
- * Print move history for both sides.
+ * Hardware performance counters read around a benchmarked kernel through
+ * Linux perf_event. Each event is opened on its own so that one missing
+ * event (common in VMs) doesn't hide the others. Elsewhere, or when the
+ * kernel refuses access, every counter reads as unavailable.
  */
-void printPastMoves(char mode) {
-    cout << "\nPast Moves:\n";
-    if (mode == '1') {
-        // Player vs Player
-        cout << "Player 1 (X): ";
-        for (size_t i = 0; i < playerMoves.size(); ++i) {
-            cout << "(" << playerMoves[i].first + 1
-                 << "," << playerMoves[i].second + 1 << ") ";
-        }
-        cout << "\nPlayer 2 (O): ";
-        for (size_t i = 0; i < computerMoves.size(); ++i) {
-            cout << "(" << computerMoves[i].first + 1
-                 << "," << computerMoves[i].second + 1 << ") ";
-        }
-    } else {
-        // Player vs Computer
-        cout << "Player (X): ";
-        for (size_t i = 0; i < playerMoves.size(); ++i) {
-            cout << "(" << playerMoves[i].first + 1
-                 << "," << playerMoves[i].second + 1 << ") ";
+class PerfCounters {
+public:
+    enum { CYCLES, INSTRUCTIONS, BRANCH_MISSES, L1D_MISSES, LLC_MISSES, DTLB_MISSES, COUNT };
+
+    PerfCounters() {
+        for (int i = 0; i < COUNT; ++i) {
+            fds[i] = -1;
+            values[i] = 0;
         }
-        cout << "\nComputer (O): ";
-        for (size_t i = 0; i < computerMoves.size(); ++i) {
-            cout << "(" << computerMoves[i].first + 1
-                 << "," << computerMoves[i].second + 1 << ") ";
+#ifdef __linux__
+        const unsigned long long cacheReadMiss =
+            (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        fds[CYCLES]        = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+        fds[INSTRUCTIONS]  = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+        fds[BRANCH_MISSES] = openEvent(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+        fds[L1D_MISSES]    = openEvent(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D | cacheReadMiss);
+        fds[LLC_MISSES]    = openEvent(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_LL | cacheReadMiss);
+        fds[DTLB_MISSES]   = openEvent(PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_DTLB | cacheReadMiss);
+#endif
+    }
+
+    ~PerfCounters() {
+#ifdef __linux__
+        for (int i = 0; i < COUNT; ++i) {
+            if (fds[i] >= 0) close(fds[i]);
         }
+#endif
     }
-    cout << "\n";
-}
 
-/**
- * Count empty spaces on a board.
- */
-int countFreeSpaces(const char b[BOARD_SIZE][BOARD_SIZE]) {
-    int freeSpaces = 0;
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        for (int j = 0; j < BOARD_SIZE; ++j) {
-            if (b[i][j] == ' ') {
-                freeSpaces++;
+    void start() {
+#ifdef __linux__
+        for (int i = 0; i < COUNT; ++i) {
+            if (fds[i] >= 0) {
+                ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+                ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
             }
         }
+#endif
     }
-    return freeSpaces;
-}
 
-/**
- * Return:
- *   'X' if player X wins
- *   'O' if player O wins
- *   'D' if draw
- *   ' ' if game not finished yet
- */
-char checkWinner(const char b[BOARD_SIZE][BOARD_SIZE]) {
-    // Check rows.
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        if (b[i][0] != ' ' &&
-            b[i][0] == b[i][1] &&
-            b[i][1] == b[i][2]) {
-            return b[i][0];
+    void stop() {
+#ifdef __linux__
+        for (int i = 0; i < COUNT; ++i) {
+            if (fds[i] >= 0) {
+                ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+                long long value = 0;
+                values[i] = (read(fds[i], &value, sizeof(value)) == sizeof(value)) ? value : 0;
+            }
         }
+#endif
     }
 
-    // Check columns.
-    for (int j = 0; j < BOARD_SIZE; ++j) {
-        if (b[0][j] != ' ' &&
-            b[0][j] == b[1][j] &&
-            b[1][j] == b[2][j]) {
-            return b[0][j];
-        }
+    bool available(int counter) const {
+        return fds[counter] >= 0;
     }
 
-    // Diagonals.
-    if (b[0][0] != ' ' &&
-        b[0][0] == b[1][1] &&
-        b[1][1] == b[2][2]) {
-        return b[0][0];
+    bool anyAvailable() const {
+        for (int i = 0; i < COUNT; ++i) {
+            if (fds[i] >= 0) return true;
+        }
+        return false;
     }
-    if (b[0][2] != ' ' &&
-        b[0][2] == b[1][1] &&
-        b[1][1] == b[2][0]) {
-        return b[0][2];
+
+    long long value(int counter) const {
+        return values[counter];
     }
 
-    // Check for draw.
-    if (countFreeSpaces(b) == 0) {
-        return 'D';
+private:
+#ifdef __linux__
+    static int openEvent(unsigned type, unsigned long long config) {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1; // user space only, allowed at perf_event_paranoid 2
+        attr.exclude_hv = 1;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
     }
+#endif
 
-    // Game is still ongoing.
-    return ' ';
-}
+    int fds[COUNT];
+    long long values[COUNT];
+};
 
-// ===============================
-// INPUT HANDLING
-// ===============================
+// Results of benchmark kernels are folded in here so they can't be optimised away.
+volatile long long benchSink = 0;
 
 /**
- * Generic function to handle one player's move (human).
- * Asks for row/column until a valid empty tile is chosen.
+ * Time `kernel` (which runs `opsPerCall` operations per call) for roughly
+ * `targetMs`, then print wall time and hardware counters per operation.
+ * The counters only see the calling thread, so a kernel that spreads work
+ * over the task pool (`usesPool`) reports them as n/a.
  */
-void handlePlayerMove(char playerChar, vector<pair<int,int> >& moveLog) {
-    int row = 0;
-    int column = 0;
-
+void runBenchmark(const char* name, const function<void()>& kernel,
+                  long long opsPerCall, int targetMs, PerfCounters& counters,
+                  bool usesPool = false) {
+    // Warm up and estimate how many calls fit in the time budget.
+    long long calls = 1;
     while (true) {
-        cout << "Enter Row and Column (1-3 1-3): ";
-
-        if (!(cin >> row)) {
-            cout << "Invalid input type. Please enter numbers only.\n";
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            continue;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (long long c = 0; c < calls; ++c) kernel();
+        long long us = elapsedMicros(start);
+        if (us >= 20000 || calls >= (1LL << 40)) {
+            calls = max(1LL, calls * targetMs * 1000 / max(1LL, us));
+            break;
         }
+        calls *= 4;
+    }
 
-        if (!(cin >> column)) {
-            cout << "Invalid input type. Please enter numbers only.\n";
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            continue;
-        }
+    AllocationScope allocations;
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    counters.start();
+    for (long long c = 0; c < calls; ++c) kernel();
+    counters.stop();
+    long long us = elapsedMicros(start);
+    AllocationCounts allocated = allocations.counts();
 
-        if (row < 1 || row > BOARD_SIZE ||
-            column < 1 || column > BOARD_SIZE) {
-            cout << "Invalid range. Please enter numbers between 1 and "
-                 << BOARD_SIZE << ".\n";
-            continue;
+    double ops = static_cast<double>(calls) * opsPerCall;
+    cout << left << setw(20) << name << right << fixed << setprecision(1)
+         << setw(12) << us * 1000.0 / ops;
+    for (int i = 0; i < PerfCounters::COUNT; ++i) {
+        if (counters.available(i) && !usesPool) {
+            cout << setw(12) << counters.value(i) / ops;
+        } else {
+            cout << setw(12) << "n/a";
         }
+    }
+    if (allocationCountingEnabled()) {
+        cout << setw(12) << allocated.allocations / ops << setw(12) << allocated.bytes / ops;
+    }
+    cout << "\n";
+}
 
-        int r = row - 1;
-        int c = column - 1;
+/**
+ * Benchmark the engine's hot kernels: checkWinner, simulateRandomGame,
+ * selectBestChild and a full minimax search from the empty board.
+ */
+void runBenchmarks(int targetMs) {
+    PerfCounters counters;
 
-        if (board[r][c] != ' ') {
-            cout << "Tile (" << row << "," << column
-                 << ") is already taken. Try again.\n";
-        } else {
-            board[r][c] = playerChar;
-            moveLog.push_back(make_pair(r, c));
-            break;
+    cout << "Benchmarks (" << targetMs << " ms per kernel, values per operation)\n";
+    if (!counters.anyAvailable()) {
+        cout << "Hardware counters unavailable (no perf_event support or "
+                "perf_event_paranoid too high); reporting wall time only.\n";
+    } else {
+        cout << "Hardware counters cover the calling thread only; kernels that "
+                "run on the task pool show n/a.\n";
+    }
+    cout << left << setw(20) << "kernel" << right << setw(12) << "ns"
+         << setw(12) << "cycles" << setw(12) << "instr" << setw(12) << "br-miss"
+         << setw(12) << "L1d-miss" << setw(12) << "LLC-miss" << setw(12) << "dTLB-miss";
+    if (allocationCountingEnabled()) {
+        cout << setw(12) << "allocs" << setw(12) << "alloc-B";
+    }
+    cout << "\n";
+
+    // checkWinner over a fixed set of random mid-game and final positions.
+    struct BenchBoard {
+        char cells[BOARD_SIZE][BOARD_SIZE];
+    };
+    const int BOARD_COUNT = 1024;
+    vector<BenchBoard> boards(BOARD_COUNT);
+    for (int b = 0; b < BOARD_COUNT; ++b) {
+        char* cells = &boards[b].cells[0][0];
+        int filled = rand() % (BOARD_SIZE * BOARD_SIZE + 1);
+        for (int k = 0; k < BOARD_SIZE * BOARD_SIZE; ++k) {
+            cells[k] = (k < filled) ? (k % 2 == 0 ? PLAYER : COMPUTER) : ' ';
+        }
+        for (int k = BOARD_SIZE * BOARD_SIZE - 1; k > 0; --k) {
+            swap(cells[k], cells[rand() % (k + 1)]);
         }
     }
-}
+    runBenchmark("checkWinner", [&]() {
+        long long sum = 0;
+        for (int b = 0; b < BOARD_COUNT; ++b) {
+            sum += checkWinner(boards[b].cells);
+        }
+        benchSink = benchSink + sum;
+    }, BOARD_COUNT, targetMs, counters);
 
-void playerMove() {
-    handlePlayerMove(PLAYER, playerMoves);
-}
+    char empty[BOARD_SIZE][BOARD_SIZE];
+    for (int i = 0; i < BOARD_SIZE; ++i) {
+        for (int j = 0; j < BOARD_SIZE; ++j) {
+            empty[i][j] = ' ';
+        }
+    }
 
-void player2Move() {
-    handlePlayerMove(COMPUTER, computerMoves);
-}
+    runBenchmark("simulateRandomGame", [&]() {
+        benchSink = benchSink + simulateRandomGame(empty, PLAYER);
+    }, 1, targetMs, counters);
 
-// ===============================
-// DIFFICULTY & RANDOM MOVE
-// ===============================
+    // selectBestChild on a fully expanded root with realistic statistics.
+    {
+        MctsTree tree(empty, 16);
+        for (int c = 0; c < BOARD_SIZE * BOARD_SIZE; ++c) {
+            char scratch[BOARD_SIZE][BOARD_SIZE];
+            memcpy(scratch, empty, sizeof(scratch));
+            MCTSNode& child = tree.node(expandNode(tree, 0, scratch, COMPUTER));
+            child.N = 100 + rand() % 1000;
+            child.W = rand() % child.N;
+            tree.node(0).N += child.N;
+        }
+        runBenchmark("selectBestChild", [&]() {
+            benchSink = benchSink + tree.node(selectBestChild(tree, 0)).N;
+        }, 1, targetMs, counters);
+    }
+    {
+        MctsTree tree(empty, 16);
+        char scratch[BOARD_SIZE][BOARD_SIZE];
+        memcpy(scratch, empty, sizeof(scratch));
+        uint32_t first = expandAllChildren(tree, 0, scratch, COMPUTER);
+        for (uint32_t c = first; c < tree.size(); ++c) {
+            tree.node(c).N = 100 + rand() % 1000;
+            tree.node(c).W = rand() % tree.node(c).N;
+            tree.node(0).N += tree.node(c).N;
+        }
+        runBenchmark("selectBestChild blk", [&]() {
+            benchSink = benchSink + tree.node(selectBestChild(tree, 0)).N;
+        }, 1, targetMs, counters);
+    }
 
-/**
- * Ask player which difficulty to use for the computer.
- * E = random, M = MCTS, H = Minimax
- */
-char selectComputerDifficulty() {
-    char aiChoice;
+    // The raw search, then the same call answered from a warm shared table.
+    minimaxUsesTable = false;
+    runBenchmark("minimax (empty)", [&]() {
+        benchSink = benchSink + minimax(empty, 0, true, INT_MIN, INT_MAX);
+    }, 1, targetMs, counters);
+    minimaxUsesTable = true;
+    if (getTranspositionTable() != NULL) {
+        runBenchmark("minimax (tt warm)", [&]() {
+            benchSink = benchSink + minimax(empty, 0, true, INT_MIN, INT_MAX);
+        }, 1, targetMs, counters);
+    }
 
-    while (true) {
-        cout << "\nSelect Computer Difficulty:\n";
-        cout << "R. Regular  (Random moves)\n";
-        cout << "H. Hard (MCTS simulations)\n";
-        cout << "I. Impossible   (Minimax algorithm)\n";
-        cout << "Enter your choice (R/H/I): ";
+    // Whole engine calls, mainly to watch allocations per move.
+    runBenchmark("runMCTS (1000 it)", [&]() {
+        benchSink = benchSink + runMCTS(empty, 1000).first;
+    }, 1, targetMs, counters);
 
-        cin >> aiChoice;
+    const bool savedExpandAll = mctsOptions.expandAll;
+    mctsOptions.expandAll = true;
+    runBenchmark("runMCTS expand-all", [&]() {
+        benchSink = benchSink + runMCTS(empty, 1000).first;
+    }, 1, targetMs, counters);
+    mctsOptions.expandAll = savedExpandAll;
 
-        if (cin.fail()) {
-            cout << "Invalid input. Please enter R, H, or I.\n";
-            cin.clear();
-            cin.ignore(numeric_limits<streamsize>::max(), '\n');
-            continue;
+    // Root moves are searched on the pool, out of the counters' sight.
+    runBenchmark("findBestMinimaxMove", [&]() {
+        benchSink = benchSink + findBestMinimaxMove(empty).first;
+    }, 1, targetMs, counters, true);
+
+    // Latency of dropping a large finished tree (1M nodes) on the caller's
+    // thread versus handing it to the reaper.
+    const bool savedDefer = deferLargeReleases;
+    for (int deferred = 0; deferred < 2; ++deferred) {
+        deferLargeReleases = deferred != 0;
+        const int TEARDOWN_NODES = 1 << 20;
+        long long totalUs = 0;
+        const int ROUNDS = 5;
+        for (int round = 0; round < ROUNDS; ++round) {
+            MctsTree* tree = new MctsTree(empty, TEARDOWN_NODES);
+            tree->allocateBlock(TEARDOWN_NODES - 1);
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            delete tree;
+            totalUs += elapsedMicros(start);
+            getArenaReaper().drain();
         }
+        cout << left << setw(20) << (deferred ? "tree free (reaper)" : "tree free (sync)")
+             << right << fixed << setprecision(1) << setw(12) << totalUs * 1000.0 / ROUNDS
+             << "  (" << TEARDOWN_NODES * sizeof(MCTSNode) / (1 << 20) << " MiB tree, ns per tree)\n";
+    }
+    deferLargeReleases = savedDefer;
 
-        aiChoice = toupper(aiChoice);
-        if (aiChoice == 'R' || aiChoice == 'H' || aiChoice == 'I') {
-            break;
+    // Random probes into a table far larger than the TLB reach, once on
+    // 4 KiB pages and once on huge pages (when the system grants them).
+    const size_t PROBE_TABLE_BYTES = 256 << 20;
+    for (int huge = 0; huge < 2; ++huge) {
+        TranspositionTable table(PROBE_TABLE_BYTES, huge != 0);
+        uint64_t state = 0x2545f4914f6cdd1dULL;
+        for (size_t k = 0; k < PROBE_TABLE_BYTES / 64; ++k) {
+            state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+            table.store(state, 1, TranspositionTable::BOUND_EXACT, 1, 0);
         }
+        const char* name = huge ? "tt probe (huge)" : "tt probe (4 KiB)";
+        runBenchmark(name, [&]() {
+            TranspositionTable::Entry entry;
+            long long found = 0;
+            for (int k = 0; k < 1024; ++k) {
+                state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+                found += table.probe(state, entry);
+            }
+            benchSink = benchSink + found;
+        }, 1024, targetMs, counters);
+        if (huge && table.pageKind() == PAGES_DEFAULT) {
+            cout << "  (huge pages unavailable; both runs used " << pageKindName(PAGES_DEFAULT) << ")\n";
+        } else if (huge) {
+            cout << "  (" << pageKindName(table.pageKind()) << ")\n";
+        }
+    }
 
-        cout << "Invalid choice. Please enter R, H, or I.\n";
+    if (!allocationCountingEnabled()) {
+        cout << "Build with -DTTT_COUNT_ALLOCATIONS to report allocations per operation.\n";
     }
-    return aiChoice;
 }
 
 /**
- * For Easy mode: pick a random empty cell.
+ * Hammer one transposition table from 1 to 64 threads (75% probes, 25%
+ * stores over a key space four times the table's capacity) and compare
+ * the lockless table against the same table behind a single mutex. Every
+ * hit is checked against the value its key was stored with, so a torn
+ * entry that slipped past the XOR check would show up as corrupt.
  */
-Move getRandomComputerMove(const char currentBoard[BOARD_SIZE][BOARD_SIZE]) {
-    vector<Move> freeSpaces;
+void runTranspositionBenchmark(int targetMs) {
+    const size_t TABLE_BYTES = max<size_t>(transpositionTableBytes, 1 << 20);
+    TranspositionTable table(TABLE_BYTES);
+    const uint64_t keySpace = table.bytes() / 16 * 4;
+    mutex tableMutex;
 
-    for (int i = 0; i < BOARD_SIZE; ++i) {
-        for (int j = 0; j < BOARD_SIZE; ++j) {
-            if (currentBoard[i][j] == ' ') {
-                freeSpaces.push_back(make_pair(i, j));
+    cout << "Transposition table contention (" << table.bytes() / 1024 << " KiB, "
+         << targetMs << " ms per run)\n";
+    cout << setw(8) << "threads" << setw(16) << "lockless Mops/s" << setw(14) << "mutex Mops/s"
+         << setw(10) << "hit %" << setw(10) << "corrupt" << "\n";
+
+    for (int threads = 1; threads <= 64; threads *= 2) {
+        double rates[2];
+        long long hits = 0, probes = 0, corrupt = 0;
+        for (int locked = 0; locked < 2; ++locked) {
+            table.clear();
+            atomic<bool> go(false), stop(false);
+            atomic<long long> totalOps(0), totalHits(0), totalProbes(0), totalCorrupt(0);
+            vector<thread> workers;
+            for (int t = 0; t < threads; ++t) {
+                workers.emplace_back([&, t]() {
+                    uint64_t state = 0x9e3779b97f4a7c15ULL * (t + 1);
+                    long long ops = 0, hitCount = 0, probeCount = 0, bad = 0;
+                    while (!go.load(memory_order_acquire)) {
+                        this_thread::yield();
+                    }
+                    while (!stop.load(memory_order_relaxed)) {
+                        for (int k = 0; k < 1024; ++k) {
+                            state ^= state << 13; state ^= state >> 7; state ^= state << 17;
+                            uint64_t hash = ((state >> 24) % keySpace + 1) * 0x9e3779b97f4a7c15ULL;
+                            int expected = static_cast<int>(hash >> 48) - 32768;
+                            TranspositionTable::Entry entry;
+                            if ((state & 3) != 0) {
+                                bool hit;
+                                if (locked) {
+                                    lock_guard<mutex> lock(tableMutex);
+                                    hit = table.probe(hash, entry);
+                                } else {
+                                    hit = table.probe(hash, entry);
+                                }
+                                probeCount++;
+                                if (hit) {
+                                    hitCount++;
+                                    if (entry.score != expected) bad++;
+                                }
+                            } else if (locked) {
+                                lock_guard<mutex> lock(tableMutex);
+                                table.store(hash, expected, TranspositionTable::BOUND_EXACT, 5, 4);
+                            } else {
+                                table.store(hash, expected, TranspositionTable::BOUND_EXACT, 5, 4);
+                            }
+                        }
+                        ops += 1024;
+                    }
+                    totalOps += ops;
+                    totalHits += hitCount;
+                    totalProbes += probeCount;
+                    totalCorrupt += bad;
+                });
+            }
+            chrono::steady_clock::time_point start = chrono::steady_clock::now();
+            go.store(true, memory_order_release);
+            this_thread::sleep_for(chrono::milliseconds(targetMs));
+            stop.store(true);
+            for (size_t t = 0; t < workers.size(); ++t) {
+                workers[t].join();
+            }
+            rates[locked] = totalOps.load() / max(1.0, static_cast<double>(elapsedMicros(start)));
+            if (!locked) {
+                hits = totalHits.load();
+                probes = totalProbes.load();
             }
+            corrupt += totalCorrupt.load();
         }
+        cout << setw(8) << threads << fixed << setprecision(1) << setw(16) << rates[0]
+             << setw(14) << rates[1] << setw(10) << 100.0 * hits / max(1LL, probes)
+             << setw(10) << corrupt << "\n";
     }
-
-    if (freeSpaces.empty()) {
-        return make_pair(-1, -1);
-    }
-
-    int randomIndex = rand() % freeSpaces.size();
-    return freeSpaces[randomIndex];
 }
 
 /**
- * Change these numbers to adjust how "smart" Medium (MCTS) feels.
- * More simulations = stronger but slower.
+ * Command-line help.
  */
-int getMctsIterationsForDifficulty(char aiChoice) {
-    if (aiChoice == 'H') {
-        // Medium: reasonable default. 
-        return 10000; // Can change number of simulatioons
-    }
-    return 0;
+void printUsage(const char* program) {
+    cout << "Usage: " << program << " [options]\n"
+            "  --ansi                       redraw the board in place instead of scrolling\n"
+            "  --leaf-parallel K            evaluate each new MCTS leaf with K parallel rollouts\n"
+            "  --mcts-time MS               give MCTS a time budget per move instead of a fixed\n"
+            "                               number of simulations\n"
+            "  --compare-leaf-parallel N    play N games per configuration comparing K=1 with\n"
+            "                               --leaf-parallel K (default 4) and exit\n"
+            "  --bench [MS]                 benchmark the engine kernels (MS per kernel,\n"
+            "                               default 300) with hardware counters of the\n"
+            "                               calling thread and exit\n"
+            "  --calibrate [GAMES]          measure Elo vs CPU time of engine settings against\n"
+            "                               reference players and pick the cheapest setting\n"
+            "                               per difficulty (default 50 games per reference)\n"
+            "  --hard-elo ELO               strength target for Hard in --calibrate (default 0)\n"
+            "  --mcts-expand-all            create all children of an MCTS node at once, as\n"
+            "                               one contiguous block\n"
+            "  --mcts-exact K               solve MCTS leaves with at most K empty cells with\n"
+            "                               minimax instead of rolling them out\n"
+            "  --mcts-mr PLIES              search PLIES plies of minimax before every rollout\n"
+            "                               move (MCTS-MR)\n"
+            "  --calibrate-hybrid [GAMES]   measure Elo of hybrid MCTS as K and the rollout\n"
+            "                               depth vary, on a fixed time per move (default 20\n"
+            "                               games per reference, 5 ms or --mcts-time)\n"
+            "  --sync-free                  release finished search trees on the searching\n"
+            "                               thread instead of a background reaper\n"
+            "  --dump-tree PATH             append a snapshot of every MCTS tree to PATH\n"
+            "  --dump-depth K               only dump the top K levels of each tree\n"
+            "  --read-tree PATH             print the principal variation and branching of\n"
+            "                               every snapshot in PATH and exit\n"
+            "  --sessions N                 play N concurrent headless games (random X vs the\n"
+            "                               --engine difficulty as O) as coroutines and exit\n"
+            "  --remote-x                   with --sessions, X's moves are delivered to the\n"
+            "                               suspended sessions from another thread, as human\n"
+            "                               moves would be\n"
+            "  --replay PATH                replay X's moves from a script (one game per line,\n"
+            "                               row/column digit pairs; \"-\" for stdin) against\n"
+            "                               the --engine difficulty and exit\n"
+            "  --engine R|H|I               computer difficulty for headless modes (default R)\n"
+            "  --log-games PATH             append every finished game to PATH from a\n"
+            "                               background writer thread\n"
+            "  --log-fsync never|batch|MS   fsync the game log never (default), after every\n"
+            "                               batch, or at most every MS milliseconds\n"
+            "  --analyze PATH               re-check every move in a game log against perfect\n"
+            "                               play, stream the blunders and summarise per player\n"
+            "  --serve-shm NAME             answer position queries from other processes over\n"
+            "                               the shared-memory ring NAME (e.g. /ttt) until Ctrl-C\n"
+            "  --shm-bench NAME [N]         send N queries (default 1000000) for the --engine\n"
+            "                               difficulty to a --serve-shm server and time them\n"
+            "  --export-dataset PATH        write every legal position, labelled with its exact\n"
+            "                               value, best moves, depth to end and symmetry class,\n"
+            "                               as a columnar binary file and exit\n"
+            "  --max-ply N                  only export positions with at most N marks\n"
+            "  --tt-mb N                    size of the shared transposition table in MiB\n"
+            "                               (default 1, 0 disables it)\n"
+            "  --no-huge-pages              keep large tables on 4 KiB pages\n"
+            "  --bench-tt [MS]              transposition table contention benchmark, 1 to 64\n"
+            "                               threads, lockless vs mutex, and exit\n"
+            "  --telemetry PATH             append one JSON line per engine move to PATH\n"
+            "                               (\"-\" for stderr)\n"
+            "  --threads N                  worker threads in the shared task pool\n"
+            "                               (default: one per extra core)\n"
+            "  --help                       show this message\n";
 }
 
 // ===============================
-// WINNER MESSAGE
+// MAIN FUNCTION / GAME LOOP
 // ===============================
 
-void printWinnerMessage(char winner, char chosenMode) {
-    if (winner == PLAYER) {
-        if (chosenMode == '1') {
-            cout << "Player 1 (X) wins!\n";
+// Left out when building the shared library (-DTICTACTOE_LIBRARY).
+#ifndef TICTACTOE_LIBRARY
+
+int main(int argc, char* argv[]) {
+    srand(static_cast<unsigned int>(time(NULL)));
+
+    // ---- Command-line options ----
+    int compareGames = 0;
+    int sessionCount = 0;
+    bool remoteSessionX = false;
+    int calibrationGames = 0;
+    int hybridGames = 0;
+    const char* replayPath = NULL;
+    const char* gameLogPath = NULL;
+    FsyncPolicy fsyncPolicy = FSYNC_NEVER;
+    int fsyncIntervalMs = 0;
+    int hardElo = 0;
+    char headlessEngine = 'R';
+    const char* shmServeName = NULL;
+    const char* shmBenchName = NULL;
+    long long shmBenchQueries = 1000000;
+    const char* datasetPath = NULL;
+    int datasetMaxPly = BOARD_SIZE * BOARD_SIZE;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--ansi") == 0) {
+            ansiRedraw = true;
+        } else if (strcmp(argv[i], "--leaf-parallel") == 0 && i + 1 < argc) {
+            mctsOptions.leafParallelRollouts = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--mcts-time") == 0 && i + 1 < argc) {
+            mctsOptions.timeBudgetMs = max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--compare-leaf-parallel") == 0 && i + 1 < argc) {
+            compareGames = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--bench") == 0) {
+            int targetMs = (i + 1 < argc && isdigit(argv[i + 1][0])) ? atoi(argv[++i]) : 300;
+            runBenchmarks(max(1, targetMs));
+            return 0;
+        } else if (strcmp(argv[i], "--bench-tt") == 0) {
+            int targetMs = (i + 1 < argc && isdigit(argv[i + 1][0])) ? atoi(argv[++i]) : 200;
+            runTranspositionBenchmark(max(1, targetMs));
+            return 0;
+        } else if (strcmp(argv[i], "--no-huge-pages") == 0) {
+            hugePagesEnabled = false;
+        } else if (strcmp(argv[i], "--tt-mb") == 0 && i + 1 < argc) {
+            transpositionTableBytes = static_cast<size_t>(max(0, atoi(argv[++i]))) << 20;
+        } else if (strcmp(argv[i], "--calibrate") == 0) {
+            calibrationGames = (i + 1 < argc && isdigit(argv[i + 1][0])) ? atoi(argv[++i]) : 50;
+            calibrationGames = max(1, calibrationGames);
+        } else if (strcmp(argv[i], "--hard-elo") == 0 && i + 1 < argc) {
+            hardElo = atoi(argv[++i]);
+        } else if (strcmp(argv[i], "--sync-free") == 0) {
+            deferLargeReleases = false;
+        } else if (strcmp(argv[i], "--mcts-expand-all") == 0) {
+            mctsOptions.expandAll = true;
+        } else if (strcmp(argv[i], "--mcts-exact") == 0 && i + 1 < argc) {
+            mctsOptions.exactLeafEmpty = min(BOARD_SIZE * BOARD_SIZE, max(0, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--mcts-mr") == 0 && i + 1 < argc) {
+            mctsOptions.rolloutPlies = min(BOARD_SIZE * BOARD_SIZE, max(0, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--calibrate-hybrid") == 0) {
+            hybridGames = (i + 1 < argc && isdigit(argv[i + 1][0])) ? atoi(argv[++i]) : 20;
+            hybridGames = max(1, hybridGames);
+        } else if (strcmp(argv[i], "--dump-tree") == 0 && i + 1 < argc) {
+            mctsOptions.dumpTreePath = argv[++i];
+        } else if (strcmp(argv[i], "--dump-depth") == 0 && i + 1 < argc) {
+            mctsOptions.dumpTreeDepth = min(255, max(0, atoi(argv[++i])));
+        } else if (strcmp(argv[i], "--read-tree") == 0 && i + 1 < argc) {
+            return readTreeSnapshots(argv[++i]) ? 0 : 1;
+        } else if (strcmp(argv[i], "--sessions") == 0 && i + 1 < argc) {
+            sessionCount = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--remote-x") == 0) {
+            remoteSessionX = true;
+        } else if (strcmp(argv[i], "--replay") == 0 && i + 1 < argc) {
+            replayPath = argv[++i];
+        } else if (strcmp(argv[i], "--engine") == 0 && i + 1 < argc) {
+            headlessEngine = static_cast<char>(toupper(argv[++i][0]));
+            if (headlessEngine != 'R' && headlessEngine != 'H' && headlessEngine != 'I') {
+                cout << "Unknown engine: " << argv[i] << " (use R, H or I)\n";
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--analyze") == 0 && i + 1 < argc) {
+            return runBlunderAnalysis(argv[++i]) ? 0 : 1;
+        } else if (strcmp(argv[i], "--serve-shm") == 0 && i + 1 < argc) {
+            shmServeName = argv[++i];
+        } else if (strcmp(argv[i], "--shm-bench") == 0 && i + 1 < argc) {
+            shmBenchName = argv[++i];
+            if (i + 1 < argc && isdigit(argv[i + 1][0])) {
+                shmBenchQueries = max(1LL, atoll(argv[++i]));
+            }
+        } else if (strcmp(argv[i], "--export-dataset") == 0 && i + 1 < argc) {
+            datasetPath = argv[++i];
+        } else if (strcmp(argv[i], "--max-ply") == 0 && i + 1 < argc) {
+            datasetMaxPly = max(0, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--log-games") == 0 && i + 1 < argc) {
+            gameLogPath = argv[++i];
+        } else if (strcmp(argv[i], "--log-fsync") == 0 && i + 1 < argc) {
+            ++i;
+            if (strcmp(argv[i], "never") == 0) {
+                fsyncPolicy = FSYNC_NEVER;
+            } else if (strcmp(argv[i], "batch") == 0) {
+                fsyncPolicy = FSYNC_BATCH;
+            } else if (isdigit(argv[i][0])) {
+                fsyncPolicy = FSYNC_INTERVAL;
+                fsyncIntervalMs = atoi(argv[i]);
+            } else {
+                cout << "Unknown fsync policy: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--telemetry") == 0 && i + 1 < argc) {
+            if (!openTelemetrySink(argv[++i])) {
+                cout << "Could not open telemetry file: " << argv[i] << "\n";
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--threads") == 0 && i + 1 < argc) {
+            engineThreads = max(1, atoi(argv[++i]));
+        } else if (strcmp(argv[i], "--help") == 0) {
+            printUsage(argv[0]);
+            return 0;
         } else {
-            cout << "Congratulations! You win!\n";
+            cout << "Unknown option: " << argv[i] << "\n";
+            printUsage(argv[0]);
+            return 1;
         }
-    } else if (winner == COMPUTER) {
-        if (chosenMode == '1') {
-            cout << "Player 2 (O) wins!\n";
-        } else {
-            cout << "Computer wins! Better luck next time!\n";
+    }
+
+    if (gameLogPath != NULL) {
+        gameLogger = GameLogger::open(gameLogPath, fsyncPolicy, fsyncIntervalMs);
+        if (gameLogger == NULL) {
+            cout << "Could not open game log: " << gameLogPath << "\n";
+            return 1;
         }
-    } else if (winner == 'D') {
-        cout << "          IT'S A TIE!\n"
-                "       |\\_,,,---,,_\n"
-                "ZZZzz /,`.-'`'    -.  ;-;;,_\n"
-                "     |,4-  ) )-,_. ,\\ (  `'-'\n"
-                "    '---''(_/--'  `-'\\_)\n";
-    } else {
-        cout << "Game ended unexpectedly.\n";
     }
-}
+    // Flush the game log and report its counters however main returns.
+    struct GameLogCloser {
+        ~GameLogCloser() {
+            if (gameLogger == NULL) {
+                return;
+            }
+            gameLogger->close();
+            GameLogger::Stats st = gameLogger->stats();
+            cerr << "Game log: " << st.recordsWritten << "/" << st.recordsLogged
+                 << " records, " << st.bytesWritten << " bytes in " << st.batches
+                 << " writes, " << st.fsyncs << " fsyncs, queue high-water "
+                 << st.queueHighWater << ", back-pressure waits "
+                 << st.backpressureWaits << "\n";
+            delete gameLogger;
+            gameLogger = NULL;
+        }
+    } gameLogCloser;
 
-// ===============================
-// MAIN FUNCTION / GAME LOOP
-// ===============================
+    if (datasetPath != NULL) {
+        return exportPositionDataset(datasetPath, datasetMaxPly) ? 0 : 1;
+    }
 
-int main() {
-    srand(static_cast<unsigned int>(time(NULL)));
+    if (shmServeName != NULL) {
+        return runShmServer(shmServeName) ? 0 : 1;
+    }
+
+    if (shmBenchName != NULL) {
+        return runShmBenchmark(shmBenchName, shmBenchQueries, headlessEngine) ? 0 : 1;
+    }
+
+    if (replayPath != NULL) {
+        return runReplay(replayPath, headlessEngine) ? 0 : 1;
+    }
+
+    if (calibrationGames > 0) {
+        runCalibration(calibrationGames, hardElo);
+        return 0;
+    }
+
+    if (hybridGames > 0) {
+        runHybridCalibration(hybridGames, (mctsOptions.timeBudgetMs > 0) ? mctsOptions.timeBudgetMs : 5);
+        return 0;
+    }
+
+    if (sessionCount > 0) {
+        runConcurrentSessions(sessionCount, headlessEngine, remoteSessionX);
+        return 0;
+    }
+
+    if (compareGames > 0) {
+        int k = (mctsOptions.leafParallelRollouts > 1) ? mctsOptions.leafParallelRollouts : 4;
+        int timeMs = (mctsOptions.timeBudgetMs > 0) ? mctsOptions.timeBudgetMs : 100;
+        compareLeafParallel(compareGames, k, timeMs);
+        return 0;
+    }
 
     cout << " _   _      _             _             \n"
             "| | (_)    | |           | |            \n"
@@ -776,14 +5560,16 @@ int main() {
 
             // ---- Single game loop ----
             while (winner == ' ' && countFreeSpaces(board) > 0) {
-                cout << "\n";
-                printBoard();
-                printPastMoves(chosenMode);
+                string status = "Current Turn: ";
+                if (chosenMode == '1') {
+                    status += (currentPlayer == PLAYER ? "Player 1 (X)\n" : "Player 2 (O)\n");
+                } else {
+                    status += (currentPlayer == PLAYER ? "Player (X)\n" : "Computer (O)\n");
+                }
+                renderFrame(chosenMode, status);
 
                 if (chosenMode == '1') {
                     // Player vs Player
-                    cout << "Current Turn: Player "
-                         << (currentPlayer == PLAYER ? "1 (X)" : "2 (O)") << "\n";
 
                     if (currentPlayer == PLAYER) {
                         playerMove();
@@ -792,10 +5578,6 @@ int main() {
                     }
                 } else {
                     // Player vs Computer
-                    cout << "Current Turn: "
-                         << (currentPlayer == PLAYER ? "Player (X)" : "Computer (O)")
-                         << "\n";
-
                     if (currentPlayer == PLAYER) {
                         playerMove();
                     } else {
@@ -809,7 +5591,14 @@ int main() {
                             mctsMove(sims);
                         } else {
                             // Easy: random move
+                            chrono::steady_clock::time_point start = chrono::steady_clock::now();
                             Move randomMove = getRandomComputerMove(board);
+                            if (telemetrySink != NULL) {
+                                SearchTelemetry t = { "random", 1, 1, 0, 0, 0,
+                                                      elapsedMicros(start), randomMove, -1.0,
+                                                      PositionKey::fromBoard(board) };
+                                emitTelemetry(t);
+                            }
                             if (randomMove.first != -1) {
                                 board[randomMove.first][randomMove.second] = COMPUTER;
                                 computerMoves.push_back(randomMove);
@@ -830,12 +5619,33 @@ int main() {
             }
 
             // ---- End of single game ----
-            cout << "\n===================================\n";
-            cout << "GAME OVER!\n";
-            printBoard();
-            printPastMoves(chosenMode);
-            printWinnerMessage(winner, chosenMode);
-            cout << "===================================\n\n";
+            string gameOver = "\n===================================\nGAME OVER!\n";
+            if (ansiRedraw) {
+                gameOver = "\x1b[H\x1b[2J" + gameOver.substr(1);
+            }
+            appendBoard(gameOver);
+            appendPastMoves(gameOver, chosenMode);
+            gameOver += winnerMessage(winner, chosenMode);
+            gameOver += "===================================\n\n";
+            writeFrame(gameOver);
+
+            if (gameLogger != NULL) {
+                // X always moves first, so the two logs interleave.
+                unsigned char played[BOARD_SIZE * BOARD_SIZE];
+                int playedCount = 0;
+                for (size_t m = 0; m < playerMoves.size() || m < computerMoves.size(); ++m) {
+                    if (m < playerMoves.size()) {
+                        played[playedCount++] = static_cast<unsigned char>(
+                            playerMoves[m].first * BOARD_SIZE + playerMoves[m].second);
+                    }
+                    if (m < computerMoves.size()) {
+                        played[playedCount++] = static_cast<unsigned char>(
+                            computerMoves[m].first * BOARD_SIZE + computerMoves[m].second);
+                    }
+                }
+                gameLogger->log(makeGameRecord('P', chosenMode == '1' ? 'P' : aiChoice,
+                                               winner, played, playedCount));
+            }
 
             cout << "Do you want to play again in the current mode? (Y/N): ";
             cin >> playAgain;
@@ -851,3 +5661,5 @@ int main() {
 
     return 0;
 }
+
+#endif // TICTACTOE_LIBRARY
@@ -0,0 +1,75 @@
+/*
+ * C interface to the TicTacToe engine.
+ *
+ * Build the shared library with
+ *     g++ -std=c++20 -O2 -pthread -shared -fPIC -DTICTACTOE_LIBRARY TicTacToe.cpp -o libtictactoe.so
+ *
+ * Positions are passed as base-3 keys: cell r * 3 + c contributes
+ * 3^(r * 3 + c) times 0 (empty), 1 (X) or 2 (O). The side to move follows
+ * from the piece counts (X moves first). Every function is thread-safe;
+ * the batch variants answer `count` positions per call so foreign callers
+ * pay the call overhead once per array rather than once per position.
+ */
+#ifndef TICTACTOE_H
+#define TICTACTOE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if defined(__GNUC__)
+#define TTT_API __attribute__((visibility("default")))
+#else
+#define TTT_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define TTT_ABI_VERSION 1
+
+/* Returned by ttt_evaluate and ttt_best_move for keys that are out of
+   range or can't arise in a game. */
+#define TTT_INVALID_POSITION (-2)
+/* Returned by ttt_best_move when the game is already over. */
+#define TTT_GAME_OVER (-1)
+
+/* Everything known about one position. */
+typedef struct ttt_result {
+    int8_t value;       /* +1 X wins, 0 draw, -1 O wins, TTT_INVALID_POSITION */
+    int8_t best_move;   /* cell of the first best move, or TTT_GAME_OVER / TTT_INVALID_POSITION */
+    uint8_t depth;      /* plies to the end under perfect play */
+    uint8_t side;       /* 'X' or 'O' to move */
+    uint16_t best_mask; /* bit per cell that keeps the value for the side to move */
+    uint16_t reserved;
+} ttt_result;
+
+/* TTT_ABI_VERSION of the loaded library. */
+TTT_API int ttt_abi_version(void);
+
+/* Key for nine cells in row-major order: 'X'/'x', 'O'/'o', anything else empty. */
+TTT_API uint32_t ttt_encode(const char cells[9]);
+
+/* Write 'X', 'O' or ' ' for each cell; returns 0, or TTT_INVALID_POSITION. */
+TTT_API int ttt_decode(uint32_t position, char cells[9]);
+
+/* Perfect-play value of a position: +1 X wins, 0 draw, -1 O wins. */
+TTT_API int ttt_evaluate(uint32_t position);
+
+/* Best cell (r * 3 + c) for the side to move. */
+TTT_API int ttt_best_move(uint32_t position);
+
+/* Full result for one position; returns its value. */
+TTT_API int ttt_analyze(uint32_t position, ttt_result* result);
+
+/* Batch variants: element i of the output describes positions[i]. */
+TTT_API void ttt_encode_batch(const char* cells, uint32_t* positions, size_t count);
+TTT_API void ttt_evaluate_batch(const uint32_t* positions, int8_t* values, size_t count);
+TTT_API void ttt_best_move_batch(const uint32_t* positions, int8_t* moves, size_t count);
+TTT_API void ttt_analyze_batch(const uint32_t* positions, ttt_result* results, size_t count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* TICTACTOE_H */